@@ -0,0 +1,159 @@
+#include "astcache.h"
+#include "flatast.h"
+#include "node.h"
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cstring>
+
+extern int yyparse();
+extern NBlock* programBlock;
+
+typedef struct yy_buffer_state* YY_BUFFER_STATE;
+extern YY_BUFFER_STATE yy_scan_string(const char* str);
+extern void yy_delete_buffer(YY_BUFFER_STATE buffer);
+
+namespace
+{
+	/* Bump whenever a tag or an operand layout changes */
+	const uint32_t astVersion = 2;
+
+	/* The file is the header and then the arrays of the flat AST, each starting on 8 bytes:
+	     uint8_t  tags[nodes]
+	     uint32_t first[nodes + 1]
+	     uint32_t operands[operandCount]
+	     uint64_t literals[literalCount]
+	     uint32_t offsets[strings + 1]
+	     char     chars[stringBytes]
+	   Everything is an index, so the file doesn't depend on where it is loaded. Loading copies the arrays
+	   into a FlatAst, which the tree is then rebuilt from. */
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint8_t source[16];
+		uint32_t nodes;
+		uint32_t operandCount;
+		uint32_t literalCount;
+		uint32_t strings;
+		uint32_t stringBytes;
+		uint32_t reserved;
+	};
+
+	struct Layout
+	{
+		uint64_t tags, first, operands, literals, offsets, chars, size;
+
+		explicit Layout(const Header& header)
+		{
+			tags = alignTo(sizeof(Header), 8);
+			first = alignTo(tags + uint64_t(header.nodes), 8);
+			operands = alignTo(first + (uint64_t(header.nodes) + 1) * 4, 8);
+			literals = alignTo(operands + uint64_t(header.operandCount) * 4, 8);
+			offsets = alignTo(literals + uint64_t(header.literalCount) * 8, 8);
+			chars = offsets + (uint64_t(header.strings) + 1) * 4;
+			size = chars + header.stringBytes;
+		}
+	};
+
+	/* data() of an empty vector may be null, which memcpy mustn't get even for no bytes */
+	template <typename T>
+	void put(std::string& data, uint64_t offset, const std::vector<T>& from)
+	{
+		if (from.empty()) return;
+		std::memcpy(&data[offset], from.data(), from.size() * sizeof(T));
+	}
+
+	void save(const FlatAst& ast, const std::string& path, const MD5::MD5Result& source)
+	{
+		Header header{};
+		std::memcpy(header.magic, "TAST", 4);
+		header.version = astVersion;
+		std::memcpy(header.source, source.Bytes.data(), sizeof header.source);
+		header.nodes = ast.size();
+		header.operandCount = static_cast<uint32_t>(ast.operands.size());
+		header.literalCount = static_cast<uint32_t>(ast.literals.size());
+		header.strings = ast.strings();
+		header.stringBytes = static_cast<uint32_t>(ast.chars.size());
+		Layout layout(header);
+
+		std::string data(layout.size, '\0');
+		std::memcpy(&data[0], &header, sizeof header);
+		put(data, layout.tags, ast.tags);
+		put(data, layout.first, ast.first);
+		put(data, layout.operands, ast.operands);
+		put(data, layout.literals, ast.literals);
+		put(data, layout.offsets, ast.offsets);
+		std::memcpy(&data[layout.chars], ast.chars.data(), ast.chars.size());
+
+		/* Runs may share the directory, so write aside and rename: nobody reads half a file */
+		auto temporary = path + "." + std::to_string(sys::Process::getProcessId());
+		std::error_code ec;
+		raw_fd_ostream out(temporary, ec, sys::fs::OF_None);
+		if (ec) return;
+		out << data;
+		out.close();
+		sys::fs::rename(temporary, path);
+	}
+
+	template <typename T>
+	void copy(std::vector<T>& to, StringRef data, uint64_t offset, uint64_t count)
+	{
+		to.resize(count);
+		if (count == 0) return;
+		std::memcpy(to.data(), data.data() + offset, count * sizeof(T));
+	}
+
+	/* Fills ast from the file, the arrays are checked when the tree is rebuilt from them */
+	bool load(FlatAst& ast, StringRef data, const MD5::MD5Result& source)
+	{
+		Header header;
+		if (data.size() < sizeof header) return false;
+		std::memcpy(&header, data.data(), sizeof header);
+		if (std::memcmp(header.magic, "TAST", 4) != 0 || header.version != astVersion) return false;
+		if (std::memcmp(header.source, source.Bytes.data(), sizeof header.source) != 0) return false;
+		Layout layout(header);
+		if (layout.size != data.size() || header.nodes == 0) return false;
+		ast.clear();
+		copy(ast.tags, data, layout.tags, header.nodes);
+		copy(ast.first, data, layout.first, uint64_t(header.nodes) + 1);
+		copy(ast.operands, data, layout.operands, header.operandCount);
+		copy(ast.literals, data, layout.literals, header.literalCount);
+		copy(ast.offsets, data, layout.offsets, uint64_t(header.strings) + 1);
+		ast.chars.assign(data.data() + layout.chars, header.stringBytes);
+		return true;
+	}
+}
+
+NBlock* parseSource(const std::string& source, const std::string& cacheDirectory, FlatAst& ast)
+{
+	std::string path;
+	MD5::MD5Result digest;
+	if (!cacheDirectory.empty()) {
+		MD5 hash;
+		hash.update(source);
+		hash.final(digest);
+		SmallString<128> file(cacheDirectory);
+		sys::path::append(file, "llvmcache-ast." + digest.digest().str().str());
+		path = file.str().str();
+		auto buffer = MemoryBuffer::getFile(path, false, false);
+		if (buffer && load(ast, (*buffer)->getBuffer(), digest)) {
+			if (auto root = ast.rebuild()) return root;
+		}
+	}
+
+	ast.clear();
+	programBlock = nullptr;
+	auto buffer = yy_scan_string(source.c_str());
+	yyparse();
+	yy_delete_buffer(buffer);
+	if (programBlock && !path.empty()) {
+		ast.indexOf(programBlock);
+		save(ast, path, digest);
+	}
+	return programBlock;
+}
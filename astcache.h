@@ -0,0 +1,10 @@
+#pragma once
+#include <string>
+
+class NBlock;
+class FlatAst;
+
+/* Parses source, or with a cache directory maps the AST a run with the same source stored there before and
+   rebuilds the tree from it without lexing or parsing. A fresh parse is stored for the next run. Either way
+   ast holds the flat form of the tree afterwards when there is a cache directory. */
+NBlock* parseSource(const std::string& source, const std::string& cacheDirectory, FlatAst& ast);
@@ -0,0 +1,23 @@
+#include "runtime.h"
+
+/* Builtins that script code calls in its hot paths. This file is linked into the compiler like the rest
+   of the runtime, and also compiled to builtins.bc, which is linked into every script module so LLVM can
+   inline these into the code that calls them. Keep it free of globals and thread locals. */
+
+int64_t toy_pow_i64(int64_t base, int64_t exponent)
+{
+	if (exponent < 0) {
+		/* Truncated toward zero, like converting the floating point power back to int */
+		if (base == 1) return 1;
+		if (base == -1) return exponent % 2 == 0 ? 1 : -1;
+		return 0;
+	}
+	auto power = static_cast<uint64_t>(base);
+	uint64_t result = 1;
+	while (exponent != 0) {
+		if (exponent & 1) result *= power;
+		power *= power;
+		exponent >>= 1;
+	}
+	return static_cast<int64_t>(result);
+}
@@ -0,0 +1,1110 @@
+#include "bytecode.h"
+#include "codegen.h"
+#include "node.h"
+#include "parser.hpp"
+#include "runtime.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+
+/* The instruction set. Every instruction is an opcode and three 32-bit operands a, b and c: registers of the
+   frame, an index into the constant pool, a jump target or a small immediate. Results go to register a. */
+#define TOY_OPCODES(X) \
+	X(Move) X(LoadK) \
+	X(AddI) X(AddIK) X(SubI) X(MulI) X(DivI) X(PowI) \
+	X(AddF) X(SubF) X(MulF) X(DivF) X(PowF) \
+	X(EqI) X(NeI) X(LtI) X(LeI) X(GtI) X(GeI) \
+	X(EqF) X(NeF) X(LtF) X(LeF) X(GtF) X(GeF) \
+	X(Not) X(IntToDouble) X(DoubleToInt) X(IntToBool) X(DoubleToBool) \
+	X(MinI) X(MaxI) X(MinF) X(MaxF) \
+	X(Jump) X(JumpIf) X(JumpIfNot) \
+	X(JumpEqI) X(JumpNeI) X(JumpLtI) X(JumpLeI) X(JumpGtI) X(JumpGeI) X(Switch) \
+	X(Ref) X(LoadRef) X(StoreRef) \
+	X(NewArray) X(ArrayLength) X(ArrayGet) X(ArraySet) X(CheckLength) \
+	X(ForPrep) X(ForNext) \
+	X(Call) X(EchoI) X(EchoF) X(Return)
+
+namespace
+{
+	enum class Op : uint8_t
+	{
+#define TOY_ENUM(name) name,
+		TOY_OPCODES(TOY_ENUM)
+#undef TOY_ENUM
+	};
+
+	union Slot;
+
+	/* Arrays are passed around as a pointer to their header, which never changes once made */
+	struct ArrayHeader
+	{
+		int64_t length;
+		Slot* data;
+	};
+
+	/* ints and bools are int64_t, a captured variable is a pointer to the register in the frame it lives in */
+	union Slot
+	{
+		int64_t i;
+		double d;
+		Slot* ref;
+		ArrayHeader* array;
+	};
+
+	ArrayHeader emptyArray = {0, nullptr};
+
+	struct Instruction
+	{
+		Op op;
+		int32_t a, b, c;
+	};
+
+	/* The arms of a match, sorted by label so Switch finds its target with a binary search */
+	struct SwitchTable
+	{
+		std::vector<int64_t> labels;
+		std::vector<int32_t> targets;
+		int32_t otherwise = 0;
+	};
+
+	/* One compiled function. The frame starts with the arguments and the pointers to the captured variables,
+	   a call lays them out right above the live registers of the caller, so they are the callee's first registers. */
+	struct Routine
+	{
+		std::string name;
+		std::vector<Instruction> code;
+		std::vector<Slot> constants;
+		std::vector<SwitchTable> switches;
+		int32_t frameSize = 0;
+		int32_t arity = 0;
+		int32_t captureLimit = 0;
+		std::vector<std::pair<std::string, int32_t>> captures;
+	};
+
+	/* Routines are referred to by index, the script itself is the first */
+	typedef std::vector<std::unique_ptr<Routine>> Program;
+
+	const uint32_t echoInt = ~0u;
+	const uint32_t echoDouble = ~0u - 1;
+
+	struct Variable
+	{
+		int32_t reg;
+		bool ref;
+		Type* type;
+	};
+
+	/* Mirrors the blocks code generation pushes, which also decides which return gives the function its value */
+	struct Scope
+	{
+		std::map<std::string, Variable> variables;
+		std::map<std::string, uint32_t> functions;
+		int32_t returnValue = -1;
+		Type* returnType = nullptr;
+	};
+
+	struct FunctionState
+	{
+		Routine* routine;
+		/* The function a local one is declared in, whose variables it captures */
+		FunctionState* outer;
+		std::vector<Scope> scopes;
+		/* Local functions by name, the first of a name is used wherever it is declared again */
+		std::map<std::string, uint32_t> declared;
+		std::map<std::string, int32_t> captured;
+		int32_t next = 0;
+		int32_t pinned = 0;
+		std::vector<bool> named;
+		/* Where code was last jumped to, the instruction before it may not be rewritten */
+		size_t label = ~size_t(0);
+	};
+
+	bool writesResult(Op op)
+	{
+		switch (op) {
+		case Op::Jump: case Op::JumpIf: case Op::JumpIfNot:
+		case Op::JumpEqI: case Op::JumpNeI: case Op::JumpLtI: case Op::JumpLeI: case Op::JumpGtI: case Op::JumpGeI: case Op::Switch:
+		case Op::Ref: case Op::StoreRef: case Op::ArraySet: case Op::CheckLength: case Op::ForPrep: case Op::ForNext: case Op::Return:
+			return false;
+		default:
+			return true;
+		}
+	}
+
+	/* Walks the tree once per function, handing out registers: variables get one of their own for the whole
+	   function, temporaries are reused from statement to statement. Returns the register holding the value of
+	   a node, -1 if it has none. */
+	class BytecodeCompiler : public NodeVisitor<BytecodeCompiler, int32_t>
+	{
+		CodeGenContext& context;
+		Program& program;
+		std::map<std::string, uint32_t> globals;
+		FunctionState* fs = nullptr;
+		Type* int64;
+		Type* real;
+
+		Routine& routine() { return *fs->routine; }
+
+		int32_t emit(Op op, int32_t a = 0, int32_t b = 0, int32_t c = 0)
+		{
+			routine().code.push_back(Instruction{op, a, b, c});
+			return static_cast<int32_t>(routine().code.size() - 1);
+		}
+
+		int32_t here()
+		{
+			fs->label = routine().code.size();
+			return static_cast<int32_t>(fs->label);
+		}
+
+		void bind(int32_t jump) { routine().code[jump].c = here(); }
+		void bindJump(int32_t jump) { routine().code[jump].a = here(); }
+
+		void grow(int32_t size)
+		{
+			routine().frameSize = std::max(routine().frameSize, size);
+			if (fs->named.size() < static_cast<size_t>(size)) fs->named.resize(size);
+		}
+
+		int32_t temp()
+		{
+			grow(fs->next + 1);
+			return fs->next++;
+		}
+
+		/* A register no later statement reuses */
+		int32_t pin()
+		{
+			auto reg = temp();
+			fs->named[reg] = true;
+			fs->pinned = fs->next;
+			return reg;
+		}
+
+		void release(int32_t mark) { fs->next = std::max(mark, fs->pinned); }
+
+		int32_t constant(Slot value)
+		{
+			auto& pool = routine().constants;
+			for (size_t k = 0; k < pool.size(); ++k) {
+				if (pool[k].i == value.i) return static_cast<int32_t>(k);
+			}
+			pool.push_back(value);
+			return static_cast<int32_t>(pool.size() - 1);
+		}
+
+		int32_t loadConstant(Slot value)
+		{
+			auto reg = temp();
+			emit(Op::LoadK, reg, constant(value));
+			return reg;
+		}
+
+		int32_t loadInt(int64_t value)
+		{
+			Slot slot;
+			slot.i = value;
+			return loadConstant(slot);
+		}
+
+		/* Makes the instruction that just computed reg write to dest instead, if nothing else can see reg */
+		bool retarget(int32_t reg, int32_t dest)
+		{
+			auto& code = routine().code;
+			if (code.empty() || fs->label == code.size() || fs->named[reg]) return false;
+			auto& last = code.back();
+			if (!writesResult(last.op) || last.a != reg) return false;
+			last.a = dest;
+			return true;
+		}
+
+		void move(int32_t dest, int32_t reg)
+		{
+			if (reg != dest && !retarget(reg, dest)) emit(Op::Move, dest, reg);
+		}
+
+		int32_t valueOf(NExpression& expr)
+		{
+			auto reg = visit(expr);
+			return reg < 0 ? loadInt(0) : reg;
+		}
+
+		bool isArray(Type* type) const
+		{
+			return type && context.arrayElementType(type);
+		}
+
+		void push() { fs->scopes.push_back(Scope()); }
+
+		Variable& define(const std::string& name, int32_t reg, Type* type)
+		{
+			auto& variable = fs->scopes.back().variables[name];
+			variable = Variable{reg, false, type};
+			return variable;
+		}
+
+		/* Looks name up the way find_locals does, through the functions a local one is declared in. A variable
+		   found outside the function becomes a capture of it, and of every function in between. */
+		bool resolve(FunctionState* state, const std::string& name, Variable& found)
+		{
+			for (auto i = state->scopes.rbegin(); i != state->scopes.rend(); ++i) {
+				auto variable = i->variables.find(name);
+				if (variable != i->variables.end()) {
+					found = variable->second;
+					return true;
+				}
+			}
+			if (!state->outer || !resolve(state->outer, name, found)) return false;
+			auto existing = state->captured.find(name);
+			if (existing == state->captured.end()) {
+				auto& routine = *state->routine;
+				auto index = static_cast<int32_t>(routine.captures.size());
+				if (index >= routine.captureLimit) {
+					std::cerr << "Too many captures in " << routine.name << std::endl;
+					exit(1);
+				}
+				existing = state->captured.emplace(name, routine.arity + index).first;
+				routine.captures.push_back(std::make_pair(name, existing->second));
+			}
+			found = Variable{existing->second, true, found.type};
+			return true;
+		}
+
+		Variable lookup(const std::string& name)
+		{
+			Variable variable;
+			if (!resolve(fs, name, variable)) {
+				std::cerr << "undeclared variable " << name << std::endl;
+				exit(1);
+			}
+			return variable;
+		}
+
+		int32_t read(const Variable& variable)
+		{
+			if (!variable.ref) return variable.reg;
+			auto reg = temp();
+			emit(Op::LoadRef, reg, variable.reg);
+			return reg;
+		}
+
+		void store(const Variable& variable, int32_t reg)
+		{
+			if (variable.ref) {
+				emit(Op::StoreRef, variable.reg, reg);
+			} else {
+				move(variable.reg, reg);
+			}
+		}
+
+		int32_t array(const NIdentifier& id)
+		{
+			auto variable = lookup(id.name);
+			if (!isArray(variable.type)) {
+				std::cerr << id.name << " is not an array" << std::endl;
+				exit(1);
+			}
+			return read(variable);
+		}
+
+		int32_t convert(int32_t reg, Type* from, Type* to)
+		{
+			if (from == to) return reg;
+			Op op;
+			if (from == int64 && to == real) op = Op::IntToDouble;
+			else if (from == real && to == int64) op = Op::DoubleToInt;
+			else if (from == int64) op = Op::IntToBool;
+			else if (from == real) op = Op::DoubleToBool;
+			else return reg;
+			auto result = temp();
+			emit(op, result, reg);
+			return result;
+		}
+
+		/* Jumps when cond is false; a comparison of ints right before it becomes a single compare and branch */
+		int32_t jumpUnless(int32_t cond)
+		{
+			auto& code = routine().code;
+			if (!code.empty() && fs->label != code.size() && !fs->named[cond] && code.back().a == cond) {
+				static const std::map<Op, Op> inverse = {
+					{Op::EqI, Op::JumpNeI}, {Op::NeI, Op::JumpEqI}, {Op::LtI, Op::JumpGeI},
+					{Op::LeI, Op::JumpGtI}, {Op::GtI, Op::JumpLeI}, {Op::GeI, Op::JumpLtI}
+				};
+				auto found = inverse.find(code.back().op);
+				if (found != inverse.end()) {
+					auto& last = code.back();
+					last = Instruction{found->second, last.b, last.c, 0};
+					return static_cast<int32_t>(code.size() - 1);
+				}
+			}
+			return emit(Op::JumpIfNot, cond, 0, 0);
+		}
+
+		void jumpTo(int32_t jump, int32_t target)
+		{
+			auto& instruction = routine().code[jump];
+			if (instruction.op == Op::JumpIfNot) instruction.b = target;
+			else instruction.c = target;
+		}
+
+		struct Leaf
+		{
+			int32_t reg;
+			Type* element;
+		};
+
+		/* Evaluates every leaf of an element-wise expression once, ahead of the loop */
+		void prepareElementwise(NExpression& expr, Type* element, int32_t length, std::map<NExpression*, Leaf>& leaves)
+		{
+			auto binop = dyn_cast<NBinaryOperator>(&expr);
+			if (binop && isArray(expr.type)) {
+				prepareElementwise(*binop->lhs, element, length, leaves);
+				prepareElementwise(*binop->rhs, element, length, leaves);
+				return;
+			}
+			auto reg = valueOf(expr);
+			if (isArray(expr.type)) {
+				auto other = temp();
+				emit(Op::ArrayLength, other, reg);
+				emit(Op::CheckLength, other, length);
+				leaves[&expr] = Leaf{reg, context.arrayElementType(expr.type)};
+			} else {
+				leaves[&expr] = Leaf{convert(reg, expr.type, element), nullptr};
+			}
+		}
+
+		int32_t emitElement(NExpression& expr, int32_t index, Type* element, std::map<NExpression*, Leaf>& leaves)
+		{
+			auto found = leaves.find(&expr);
+			if (found != leaves.end()) {
+				if (!found->second.element) return found->second.reg;
+				auto value = temp();
+				emit(Op::ArrayGet, value, found->second.reg, index);
+				return convert(value, found->second.element, element);
+			}
+			auto& binop = static_cast<NBinaryOperator&>(expr);
+			auto lhs = emitElement(*binop.lhs, index, element, leaves);
+			auto rhs = emitElement(*binop.rhs, index, element, leaves);
+			auto fp = element == real;
+			Op op;
+			switch (binop.op) {
+			case TPLUS: op = fp ? Op::AddF : Op::AddI; break;
+			case TMINUS: op = fp ? Op::SubF : Op::SubI; break;
+			case TMUL: op = fp ? Op::MulF : Op::MulI; break;
+			default: op = fp ? Op::DivF : Op::DivI; break;
+			}
+			auto result = temp();
+			emit(op, result, lhs, rhs);
+			return result;
+		}
+
+		/* Stores rhs into every element of the array in variable, every array in rhs must be as long */
+		int32_t assignElementwise(const Variable& variable, NExpression& rhs)
+		{
+			auto element = context.arrayElementType(variable.type);
+			auto header = read(variable);
+			auto length = temp();
+			emit(Op::ArrayLength, length, header);
+			std::map<NExpression*, Leaf> leaves;
+			prepareElementwise(rhs, element, length, leaves);
+			auto index = loadInt(0);
+			auto top = here();
+			auto exit = emit(Op::JumpGeI, index, length, 0);
+			auto mark = fs->next;
+			auto value = emitElement(rhs, index, element, leaves);
+			emit(Op::ArraySet, header, index, value);
+			release(mark);
+			emit(Op::AddIK, index, index, 1);
+			emit(Op::Jump, top);
+			bind(exit);
+			push();
+			return header;
+		}
+
+		/* Registers base..base + 3 hold from, to (the trip count once prepared), step and the iteration */
+		void countedLoop(int32_t base, Variable iv, NBlock& body)
+		{
+			emit(Op::ForPrep, base);
+			auto top = here();
+			auto exit = emit(Op::ForNext, base, iv.reg, 0);
+			visit(body);
+			emit(Op::Jump, top);
+			bind(exit);
+		}
+
+		void compileFunction(NFunctionDeclaration& node, uint32_t index, FunctionState* outer)
+		{
+			auto& routine = *program[index];
+			routine.arity = static_cast<int32_t>(node.arguments.size());
+			if (outer) {
+				/* Anything it names could turn out to be a capture, they get a place right after the arguments */
+				std::set<std::string> vars, calls, defined;
+				collectNames(context.ast, context.ast.indexOf(&node), vars, calls, defined);
+				routine.captureLimit = static_cast<int32_t>(vars.size());
+			}
+			FunctionState state;
+			state.routine = &routine;
+			state.outer = outer;
+			state.next = state.pinned = routine.arity + routine.captureLimit;
+			auto saved = fs;
+			fs = &state;
+			grow(state.next);
+			push();
+			for (int32_t i = 0; i < routine.arity; ++i) {
+				auto arg = node.arguments[i];
+				define(arg->id.name, i, typeOf(arg->type, context));
+				fs->named[i] = true;
+			}
+			auto value = visit(node.block);
+			if (fs->scopes.back().returnValue >= 0) value = fs->scopes.back().returnValue;
+			emit(Op::Return, value < 0 ? loadInt(0) : value);
+			fs = saved;
+		}
+
+		uint32_t addRoutine(const std::string& name)
+		{
+			program.emplace_back(new Routine());
+			program.back()->name = name;
+			return static_cast<uint32_t>(program.size() - 1);
+		}
+
+	public:
+		BytecodeCompiler(CodeGenContext& context, Program& program) : context(context), program(program)
+		{
+			int64 = Type::getInt64Ty(context.llvmContext);
+			real = Type::getDoubleTy(context.llvmContext);
+			globals["echo"] = echoInt;
+			globals["echod"] = echoDouble;
+		}
+
+		void compile(NBlock& root)
+		{
+			auto index = addRoutine("main");
+			FunctionState state;
+			state.routine = program[index].get();
+			state.outer = nullptr;
+			fs = &state;
+			push();
+			visit(root);
+			/* The script returns 0 unless it says otherwise, its last value doesn't count */
+			auto& scope = fs->scopes.back();
+			if (scope.returnValue >= 0 && scope.returnType != int64) {
+				std::cerr << "Main must return Int64!" << std::endl;
+				exit(0);
+			}
+			emit(Op::Return, scope.returnValue >= 0 ? scope.returnValue : loadInt(0));
+			fs = nullptr;
+		}
+
+		int32_t visitBool(NBool& node) { return loadInt(node.value); }
+		int32_t visitInteger(NInteger& node) { return loadInt(node.value); }
+
+		int32_t visitDouble(NDouble& node)
+		{
+			Slot slot;
+			slot.d = node.value;
+			return loadConstant(slot);
+		}
+
+		int32_t visitIdentifier(NIdentifier& node) { return read(lookup(node.name)); }
+
+		int32_t visitMethodCall(NMethodCall& node)
+		{
+			uint32_t index = 0;
+			auto known = false;
+			auto global = globals.find(node.id.name);
+			if (global != globals.end()) {
+				index = global->second;
+				known = true;
+			}
+			/* Local functions are only seen from the function they are declared in */
+			for (auto i = fs->scopes.rbegin(); i != fs->scopes.rend() && !known; ++i) {
+				auto found = i->functions.find(node.id.name);
+				if (found != i->functions.end()) {
+					index = found->second;
+					known = true;
+				}
+			}
+			if (!known) {
+				std::cerr << "No such function " << node.id.name << std::endl;
+				exit(1);
+			}
+			if (index == echoInt || index == echoDouble) {
+				auto value = valueOf(*node.arguments.at(0));
+				auto result = temp();
+				emit(index == echoInt ? Op::EchoI : Op::EchoF, result, value);
+				return result;
+			}
+
+			auto& callee = *program[index];
+			auto arguments = static_cast<int32_t>(node.arguments.size());
+			auto window = fs->next;
+			fs->next += arguments;
+			grow(fs->next);
+			for (int32_t i = 0; i < arguments; ++i) {
+				move(window + i, valueOf(*node.arguments[i]));
+			}
+			if (fs->pinned > window) {
+				/* An argument defined a variable, which the callee's frame would overwrite */
+				auto moved = fs->next;
+				for (int32_t i = 0; i < arguments; ++i) emit(Op::Move, moved + i, window + i);
+				window = moved;
+			}
+			for (auto const& capture : callee.captures) {
+				auto variable = lookup(capture.first);
+				emit(variable.ref ? Op::Move : Op::Ref, window + capture.second, variable.reg);
+			}
+			grow(window + callee.arity + callee.captureLimit);
+			fs->next = window + 1;
+			emit(Op::Call, window, static_cast<int32_t>(index), window);
+			return window;
+		}
+
+		int32_t visitBinaryOperator(NBinaryOperator& node)
+		{
+			if (isArray(node.type)) {
+				std::cerr << "element-wise expressions can only be assigned to an array" << std::endl;
+				exit(1);
+			}
+			auto lhs = valueOf(*node.lhs);
+			if (node.op == TNOT) {
+				auto result = temp();
+				emit(Op::Not, result, lhs);
+				return result;
+			}
+			if (node.op == TAND || node.op == TOR) {
+				/* The rhs is skipped once the lhs decides */
+				auto result = temp();
+				move(result, lhs);
+				auto decided = emit(node.op == TAND ? Op::JumpIfNot : Op::JumpIf, result, 0);
+				move(result, valueOf(*node.rhs));
+				routine().code[decided].b = here();
+				return result;
+			}
+			auto fp = node.lhs->type != int64;
+			auto constant = dyn_cast<NInteger>(node.rhs);
+			if (!fp && constant && (node.op == TPLUS || node.op == TMINUS) && constant->value >= -INT32_MAX && constant->value <= INT32_MAX) {
+				auto result = temp();
+				emit(Op::AddIK, result, lhs, static_cast<int32_t>(node.op == TPLUS ? constant->value : -constant->value));
+				return result;
+			}
+			auto rhs = valueOf(*node.rhs);
+			Op op;
+			switch (node.op) {
+			case TPLUS: op = fp ? Op::AddF : Op::AddI; break;
+			case TMINUS: op = fp ? Op::SubF : Op::SubI; break;
+			case TMUL: op = fp ? Op::MulF : Op::MulI; break;
+			case TDIV: op = fp ? Op::DivF : Op::DivI; break;
+			case TPOW: op = fp ? Op::PowF : Op::PowI; break;
+			case TCEQ: op = fp ? Op::EqF : Op::EqI; break;
+			case TCNE: op = fp ? Op::NeF : Op::NeI; break;
+			case TCLT: op = fp ? Op::LtF : Op::LtI; break;
+			case TCLE: op = fp ? Op::LeF : Op::LeI; break;
+			case TCGT: op = fp ? Op::GtF : Op::GtI; break;
+			case TCGE: op = fp ? Op::GeF : Op::GeI; break;
+			default:
+				std::cerr << "Error binop used" << std::endl;
+				exit(1);
+			}
+			auto result = temp();
+			emit(op, result, lhs, rhs);
+			return result;
+		}
+
+		int32_t visitAssignment(NAssignment& node)
+		{
+			auto variable = lookup(node.lhs.name);
+			if (isArray(variable.type)) {
+				return assignElementwise(variable, *node.rhs);
+			}
+			store(variable, valueOf(*node.rhs));
+			return -1;
+		}
+
+		int32_t visitArrayIndex(NArrayIndex& node)
+		{
+			auto header = array(node.id);
+			auto index = valueOf(*node.index);
+			auto result = temp();
+			emit(Op::ArrayGet, result, header, index);
+			return result;
+		}
+
+		int32_t visitArrayAssignment(NArrayAssignment& node)
+		{
+			auto header = array(node.id);
+			auto index = valueOf(*node.index);
+			emit(Op::ArraySet, header, index, valueOf(*node.rhs));
+			return -1;
+		}
+
+		int32_t visitArrayLength(NArrayLength& node)
+		{
+			auto header = array(node.id);
+			auto result = temp();
+			emit(Op::ArrayLength, result, header);
+			return result;
+		}
+
+		int32_t visitCast(NCast& node)
+		{
+			return convert(valueOf(*node.expression), node.expression->type, node.type);
+		}
+
+		int32_t visitBlock(NBlock& node)
+		{
+			int32_t last = -1;
+			for (size_t i = 0; i < node.statements.size(); ++i) {
+				auto mark = fs->next;
+				last = visit(*node.statements[i]);
+				if (i + 1 < node.statements.size()) release(mark);
+			}
+			return last;
+		}
+
+		int32_t visitExpressionStatement(NExpressionStatement& node) { return visit(*node.expression); }
+
+		int32_t visitReturnStatement(NReturnStatement& node)
+		{
+			auto value = valueOf(*node.expression);
+			auto result = pin();
+			move(result, value);
+			fs->scopes.back().returnValue = result;
+			fs->scopes.back().returnType = node.expression->type;
+			return result;
+		}
+
+		int32_t visitIfBlock(NIfBlock& node)
+		{
+			auto depth = fs->scopes.size();
+			push();
+			auto cond = valueOf(*node.cond);
+			auto result = node.type && !node.type->isVoidTy() ? temp() : -1;
+			auto otherwise = jumpUnless(cond);
+
+			push();
+			auto value = visit(*node.thenblock);
+			if (result >= 0) move(result, value < 0 ? loadInt(0) : value);
+			fs->scopes.resize(depth + 1);
+			auto done = emit(Op::Jump);
+
+			jumpTo(otherwise, here());
+			push();
+			value = visit(*node.elseblock);
+			if (result >= 0) move(result, value < 0 ? loadInt(0) : value);
+			fs->scopes.resize(depth);
+			bindJump(done);
+			push();
+			return result;
+		}
+
+		int32_t visitMatch(NMatch& node)
+		{
+			auto depth = fs->scopes.size();
+			push();
+			auto subject = valueOf(*node.subject);
+			auto result = node.type && !node.type->isVoidTy() ? temp() : -1;
+			auto table = static_cast<int32_t>(routine().switches.size());
+			routine().switches.emplace_back();
+			emit(Op::Switch, subject, table);
+
+			std::vector<std::pair<int64_t, int32_t>> targets;
+			std::vector<int32_t> done;
+			auto generateArm = [&](NExpression& expr) {
+				auto start = here();
+				push();
+				auto value = visit(expr);
+				if (result >= 0) move(result, value < 0 ? loadInt(0) : value);
+				fs->scopes.resize(depth + 1);
+				done.push_back(emit(Op::Jump));
+				return start;
+			};
+			for (auto const& arm : node.cases) targets.push_back(std::make_pair(arm.first, generateArm(*arm.second)));
+			auto otherwise = generateArm(*node.otherwise);
+			fs->scopes.resize(depth);
+			auto end = here();
+			for (auto jump : done) routine().code[jump].a = end;
+
+			std::sort(targets.begin(), targets.end());
+			auto& switchTable = routine().switches[table];
+			for (auto const& target : targets) {
+				switchTable.labels.push_back(target.first);
+				switchTable.targets.push_back(target.second);
+			}
+			switchTable.otherwise = otherwise;
+			push();
+			return result;
+		}
+
+		int32_t visitWhileBlock(NWhileBlock& node)
+		{
+			auto depth = fs->scopes.size();
+			push();
+			auto top = here();
+			auto mark = fs->next;
+			auto exit = jumpUnless(valueOf(*node.cond));
+			release(mark);
+			push();
+			visit(node.doblock);
+			release(mark);
+			emit(Op::Jump, top);
+			jumpTo(exit, here());
+			fs->scopes.resize(depth);
+			push();
+			return -1;
+		}
+
+		int32_t visitForBlock(NForBlock& node)
+		{
+			auto base = fs->next;
+			fs->next += 4;
+			grow(fs->next);
+			move(base, valueOf(*node.from));
+			move(base + 1, valueOf(*node.to));
+			move(base + 2, node.step ? valueOf(*node.step) : loadInt(1));
+			auto depth = fs->scopes.size();
+			push();
+			push();
+			auto iv = define(node.id.name, pin(), int64);
+			countedLoop(base, iv, node.doblock);
+			fs->scopes.resize(depth);
+			push();
+			return base + 1;
+		}
+
+		/* Runs the iterations in order on this thread, the reduction variable still gets a private accumulator */
+		int32_t visitParallelFor(NParallelFor& node)
+		{
+			auto base = fs->next;
+			fs->next += 4;
+			grow(fs->next);
+			move(base, valueOf(*node.from));
+			move(base + 1, valueOf(*node.to));
+			move(base + 2, loadInt(1));
+
+			Variable reduction{-1, false, int64};
+			Slot identity;
+			identity.i = 0;
+			auto op = Op::AddI;
+			if (node.reduction) {
+				reduction = lookup(node.reduction->name);
+				auto fp = reduction.type == real;
+				if (!fp && reduction.type != int64) {
+					std::cerr << "reduction variable " << node.reduction->name << " must be int or double" << std::endl;
+					exit(1);
+				}
+				if (node.reduceOp == "+") {
+					op = fp ? Op::AddF : Op::AddI;
+					if (fp) identity.d = 0.0;
+				} else if (node.reduceOp == "*") {
+					op = fp ? Op::MulF : Op::MulI;
+					if (fp) identity.d = 1.0; else identity.i = 1;
+				} else if (node.reduceOp == "min") {
+					op = fp ? Op::MinF : Op::MinI;
+					if (fp) identity.d = HUGE_VAL; else identity.i = std::numeric_limits<int64_t>::max();
+				} else if (node.reduceOp == "max") {
+					op = fp ? Op::MaxF : Op::MaxI;
+					if (fp) identity.d = -HUGE_VAL; else identity.i = std::numeric_limits<int64_t>::min();
+				} else {
+					std::cerr << "unknown reduction " << node.reduceOp << std::endl;
+					exit(1);
+				}
+			}
+
+			auto depth = fs->scopes.size();
+			push();
+			int32_t accumulator = -1;
+			if (node.reduction) {
+				accumulator = define(node.reduction->name, pin(), reduction.type).reg;
+				emit(Op::LoadK, accumulator, constant(identity));
+			}
+			auto iv = define(node.id.name, pin(), int64);
+			countedLoop(base, iv, node.doblock);
+			fs->scopes.resize(depth);
+
+			if (!node.reduction) return loadInt(0);
+			auto result = temp();
+			emit(op, result, read(reduction), accumulator);
+			store(reduction, result);
+			return result;
+		}
+
+		int32_t visitVariableDefinition(NVariableDefinition& node)
+		{
+			auto type = typeOf(node.type, context);
+			if (node.immutable) {
+				/* A let's initializer still sees the name as it was */
+				auto value = valueOf(*node.assignmentExpr);
+				move(define(node.id.name, pin(), type).reg, value);
+				return -1;
+			}
+			auto variable = define(node.id.name, pin(), type);
+			if (isArray(type)) {
+				/* int[] variables alias the array they are initialized with */
+				if (node.assignmentExpr) {
+					move(variable.reg, valueOf(*node.assignmentExpr));
+				} else {
+					Slot empty;
+					empty.array = &emptyArray;
+					emit(Op::LoadK, variable.reg, constant(empty));
+				}
+			} else if (node.assignmentExpr) {
+				store(variable, valueOf(*node.assignmentExpr));
+			} else {
+				emit(Op::LoadK, variable.reg, constant(Slot{0}));
+			}
+			return -1;
+		}
+
+		int32_t visitArrayDefinition(NArrayDefinition& node)
+		{
+			auto element = typeOf(node.type, context);
+			auto length = valueOf(*node.size);
+			auto variable = define(node.id.name, pin(), context.arrayType(element));
+			emit(Op::NewArray, variable.reg, length);
+			if (node.assignmentExpr) assignElementwise(variable, *node.assignmentExpr);
+			return variable.reg;
+		}
+
+		int32_t visitExternDeclaration(NExternDeclaration& node)
+		{
+			std::cerr << "extern " << node.id.name << " can't be interpreted" << std::endl;
+			exit(1);
+		}
+
+		int32_t visitFunctionDeclaration(NFunctionDeclaration& node)
+		{
+			auto& name = node.id.name;
+			if (!node.local) {
+				/* The first definition wins, and may call itself */
+				if (globals.count(name)) return -1;
+				auto index = addRoutine(name);
+				globals[name] = index;
+				compileFunction(node, index, nullptr);
+				return -1;
+			}
+			auto found = fs->declared.find(name);
+			if (found == fs->declared.end()) {
+				auto index = addRoutine(name);
+				compileFunction(node, index, fs);
+				found = fs->declared.emplace(name, index).first;
+			}
+			fs->scopes.back().functions[name] = found->second;
+			return -1;
+		}
+
+		int32_t visitVariableDeclaration(NVariableDeclaration&) { return -1; }
+	};
+
+	/* Runs routines on one stack of slots. The arrays a call makes are freed when it returns, like the allocas
+	   of native code: arrays aren't returned and assigning one copies its elements, so none outlives its frame. */
+	class Interpreter
+	{
+		Program& program;
+		std::unique_ptr<Slot[]> stack;
+		Slot* stackEnd;
+		std::vector<std::unique_ptr<Slot[]>> arrays;
+		std::vector<std::unique_ptr<ArrayHeader>> headers;
+
+		ArrayHeader* newArray(int64_t length)
+		{
+			arrays.emplace_back(new Slot[std::max<int64_t>(length, 0)]());
+			headers.emplace_back(new ArrayHeader{length, arrays.back().get()});
+			return headers.back().get();
+		}
+
+		/* Frees the arrays made since there were mark of them */
+		void releaseArrays(size_t mark)
+		{
+			arrays.resize(mark);
+			headers.resize(mark);
+		}
+
+		[[noreturn]] void overflow(const Routine& routine)
+		{
+			std::cerr << "Stack overflow calling " << routine.name << std::endl;
+			exit(1);
+		}
+
+	public:
+		explicit Interpreter(Program& program, size_t slots = size_t(1) << 22) :
+			program(program), stack(new Slot[slots]), stackEnd(stack.get() + slots) { }
+
+		int64_t run()
+		{
+			if (program[0]->frameSize > stackEnd - stack.get()) overflow(*program[0]);
+			return run(*program[0], stack.get()).i;
+		}
+
+		Slot run(const Routine& routine, Slot* r);
+	};
+
+	/* Threaded dispatch where the compiler has computed gotos, every handler jumps straight to the next one */
+	Slot Interpreter::run(const Routine& routine, Slot* r)
+	{
+		auto code = routine.code.data();
+		auto k = routine.constants.data();
+		auto pc = code;
+#if defined(__GNUC__)
+#define TOY_LABEL(name) &&op##name,
+		static void* const labels[] = { TOY_OPCODES(TOY_LABEL) };
+#undef TOY_LABEL
+#define TOY_CASE(name) op##name:
+#define TOY_DISPATCH() goto *labels[static_cast<uint8_t>(pc->op)]
+		TOY_DISPATCH();
+#else
+#define TOY_CASE(name) case Op::name:
+#define TOY_DISPATCH() continue
+		for (;;) switch (pc->op) {
+#endif
+#define TOY_NEXT() ++pc; TOY_DISPATCH()
+#define TOY_JUMP(target) pc = code + (target); TOY_DISPATCH()
+#define A r[pc->a]
+#define B r[pc->b]
+#define C r[pc->c]
+#define WRAP(x, op, y) static_cast<int64_t>(static_cast<uint64_t>(x) op static_cast<uint64_t>(y))
+		TOY_CASE(Move) A = B; TOY_NEXT();
+		TOY_CASE(LoadK) A = k[pc->b]; TOY_NEXT();
+		TOY_CASE(AddI) A.i = WRAP(B.i, +, C.i); TOY_NEXT();
+		TOY_CASE(AddIK) A.i = WRAP(B.i, +, pc->c); TOY_NEXT();
+		TOY_CASE(SubI) A.i = WRAP(B.i, -, C.i); TOY_NEXT();
+		TOY_CASE(MulI) A.i = WRAP(B.i, *, C.i); TOY_NEXT();
+		TOY_CASE(DivI) A.i = B.i / C.i; TOY_NEXT();
+		TOY_CASE(PowI) A.i = toy_pow_i64(B.i, C.i); TOY_NEXT();
+		TOY_CASE(AddF) A.d = B.d + C.d; TOY_NEXT();
+		TOY_CASE(SubF) A.d = B.d - C.d; TOY_NEXT();
+		TOY_CASE(MulF) A.d = B.d * C.d; TOY_NEXT();
+		TOY_CASE(DivF) A.d = B.d / C.d; TOY_NEXT();
+		TOY_CASE(PowF) A.d = std::pow(B.d, C.d); TOY_NEXT();
+		TOY_CASE(EqI) A.i = B.i == C.i; TOY_NEXT();
+		TOY_CASE(NeI) A.i = B.i != C.i; TOY_NEXT();
+		TOY_CASE(LtI) A.i = B.i < C.i; TOY_NEXT();
+		TOY_CASE(LeI) A.i = B.i <= C.i; TOY_NEXT();
+		TOY_CASE(GtI) A.i = B.i > C.i; TOY_NEXT();
+		TOY_CASE(GeI) A.i = B.i >= C.i; TOY_NEXT();
+		/* As the IR compares: ordered except for !=, > and >=, which are true on NaN */
+		TOY_CASE(EqF) A.i = B.d == C.d; TOY_NEXT();
+		TOY_CASE(NeF) A.i = B.d != C.d; TOY_NEXT();
+		TOY_CASE(LtF) A.i = B.d < C.d; TOY_NEXT();
+		TOY_CASE(LeF) A.i = B.d <= C.d; TOY_NEXT();
+		TOY_CASE(GtF) A.i = !(B.d <= C.d); TOY_NEXT();
+		TOY_CASE(GeF) A.i = !(B.d < C.d); TOY_NEXT();
+		TOY_CASE(Not) A.i = !B.i; TOY_NEXT();
+		TOY_CASE(IntToDouble) A.d = static_cast<double>(B.i); TOY_NEXT();
+		TOY_CASE(DoubleToInt) A.i = static_cast<int64_t>(B.d); TOY_NEXT();
+		TOY_CASE(IntToBool) A.i = B.i != 0; TOY_NEXT();
+		TOY_CASE(DoubleToBool) A.i = B.d < 0.0 || B.d > 0.0; TOY_NEXT();
+		TOY_CASE(MinI) A = C.i < B.i ? C : B; TOY_NEXT();
+		TOY_CASE(MaxI) A = C.i < B.i ? B : C; TOY_NEXT();
+		TOY_CASE(MinF) A = C.d < B.d ? C : B; TOY_NEXT();
+		TOY_CASE(MaxF) A = C.d < B.d ? B : C; TOY_NEXT();
+		TOY_CASE(Jump) TOY_JUMP(pc->a);
+		TOY_CASE(JumpIf) if (A.i) { TOY_JUMP(pc->b); } TOY_NEXT();
+		TOY_CASE(JumpIfNot) if (!A.i) { TOY_JUMP(pc->b); } TOY_NEXT();
+		TOY_CASE(JumpEqI) if (A.i == B.i) { TOY_JUMP(pc->c); } TOY_NEXT();
+		TOY_CASE(JumpNeI) if (A.i != B.i) { TOY_JUMP(pc->c); } TOY_NEXT();
+		TOY_CASE(JumpLtI) if (A.i < B.i) { TOY_JUMP(pc->c); } TOY_NEXT();
+		TOY_CASE(JumpLeI) if (A.i <= B.i) { TOY_JUMP(pc->c); } TOY_NEXT();
+		TOY_CASE(JumpGtI) if (A.i > B.i) { TOY_JUMP(pc->c); } TOY_NEXT();
+		TOY_CASE(JumpGeI) if (A.i >= B.i) { TOY_JUMP(pc->c); } TOY_NEXT();
+		TOY_CASE(Switch) {
+			auto& table = routine.switches[pc->b];
+			auto found = std::lower_bound(table.labels.begin(), table.labels.end(), A.i);
+			if (found == table.labels.end() || *found != A.i) { TOY_JUMP(table.otherwise); }
+			TOY_JUMP(table.targets[found - table.labels.begin()]);
+		}
+		TOY_CASE(Ref) A.ref = &B; TOY_NEXT();
+		TOY_CASE(LoadRef) A = *B.ref; TOY_NEXT();
+		TOY_CASE(StoreRef) *A.ref = B; TOY_NEXT();
+		TOY_CASE(NewArray) A.array = newArray(B.i); TOY_NEXT();
+		TOY_CASE(ArrayLength) A.i = B.array->length; TOY_NEXT();
+		/* Unsigned, so a negative index is out of bounds as well */
+		TOY_CASE(ArrayGet) {
+			if (static_cast<uint64_t>(C.i) >= static_cast<uint64_t>(B.array->length)) toy_index_error(C.i, B.array->length);
+			A = B.array->data[C.i];
+			TOY_NEXT();
+		}
+		TOY_CASE(ArraySet) {
+			if (static_cast<uint64_t>(B.i) >= static_cast<uint64_t>(A.array->length)) toy_index_error(B.i, A.array->length);
+			A.array->data[B.i] = C;
+			TOY_NEXT();
+		}
+		TOY_CASE(CheckLength) if (A.i != B.i) { toy_length_error(A.i, B.i); } TOY_NEXT();
+		TOY_CASE(ForPrep) {
+			/* The trip count is fixed on entry and unsigned, as the counted loop of the code generator has it.
+			   A step of 0 runs no iterations. */
+			auto from = A.i;
+			auto& to = r[pc->a + 1].i;
+			auto step = r[pc->a + 2].i;
+			auto runs = step > 0 ? from < to : step < 0 && from > to;
+			auto span = step > 0 ? static_cast<uint64_t>(to) - static_cast<uint64_t>(from) : static_cast<uint64_t>(from) - static_cast<uint64_t>(to);
+			auto magnitude = step > 0 ? static_cast<uint64_t>(step) : 0 - static_cast<uint64_t>(step);
+			to = runs ? static_cast<int64_t>((span - 1) / magnitude + 1) : 0;
+			r[pc->a + 3].i = 0;
+			TOY_NEXT();
+		}
+		TOY_CASE(ForNext) {
+			auto& iteration = r[pc->a + 3].i;
+			if (static_cast<uint64_t>(iteration) >= static_cast<uint64_t>(r[pc->a + 1].i)) { TOY_JUMP(pc->c); }
+			B.i = WRAP(A.i, +, WRAP(iteration, *, r[pc->a + 2].i));
+			iteration = WRAP(iteration, +, 1);
+			TOY_NEXT();
+		}
+		TOY_CASE(Call) {
+			auto& callee = *program[pc->b];
+			auto frame = &C;
+			if (callee.frameSize > stackEnd - frame) overflow(callee);
+			auto mark = arrays.size();
+			A = run(callee, frame);
+			releaseArrays(mark);
+			TOY_NEXT();
+		}
+		TOY_CASE(EchoI) toy_echo_i64(B.i); A = B; TOY_NEXT();
+		TOY_CASE(EchoF) toy_echo_f64(B.d); A = B; TOY_NEXT();
+		TOY_CASE(Return) return A;
+#if defined(__GNUC__)
+		llvm_unreachable("Bytecode ran off its end");
+#endif
+#undef WRAP
+#undef C
+#undef B
+#undef A
+#undef TOY_JUMP
+#undef TOY_NEXT
+#undef TOY_DISPATCH
+#undef TOY_CASE
+#if !defined(__GNUC__)
+		}
+#endif
+	}
+}
+
+bool interpret(NBlock& root, CodeGenContext& context, int64_t& result)
+{
+	if (!context.ast.contains(&root)) {
+		context.ast.clear();
+		context.ast.indexOf(&root);
+	}
+	for (auto tag : context.ast.tags) {
+		if (tag == NodeKind::ExternDeclaration) {
+			context.dclog << debug_stream::info << "Externs need native code, not interpreting" << std::endl;
+			return false;
+		}
+	}
+	context.prepareTree(root);
+
+	context.dclog << debug_stream::info << "Compiling bytecode..." << std::endl;
+	Program program;
+	BytecodeCompiler(context, program).compile(root);
+	size_t instructions = 0;
+	for (auto const& routine : program) instructions += routine->code.size();
+	context.dclog << debug_stream::info << program.size() << " routines, " << instructions << " instructions" << std::endl;
+
+	context.dclog << debug_stream::info << "Interpreting..." << std::endl;
+	Interpreter interpreter(program);
+	result = interpreter.run();
+	toy_flush_output();
+	context.dclog << debug_stream::info << "Code was run." << std::endl;
+	return true;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <cstdint>
+
+class NBlock;
+class CodeGenContext;
+
+/* Compiles the script under root to register bytecode and runs it, without generating any LLVM IR. Returns
+   false, having run nothing, if the script declares externs, which only native code can call. */
+bool interpret(NBlock& root, CodeGenContext& context, int64_t& result);
@@ -0,0 +1,95 @@
+/* Thin client for the compile server started with --daemon <socket>.
+   It needs no LLVM, only the C++ standard library and POSIX sockets. It reads the
+   script from stdin and lets the server write the script's output directly to
+   this process' stdout and stderr. Built by the Makefile: make toyc
+
+   usage: toyc <socket> [-c] [-O] [--log<level>] < script
+*/
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static bool writeAll(int fd, const char* data, size_t size)
+{
+	while (size) {
+		auto n = write(fd, data, size);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		std::cerr << "usage: " << argv[0] << " <socket> [-c] [-O] [--log<level>] < script" << std::endl;
+		return 2;
+	}
+	std::string options;
+	for (auto i = 2; i < argc; ++i) {
+		options += std::string(argv[i]) + " ";
+	}
+	options += "\n";
+	std::string source;
+	char buffer[4096];
+	size_t n;
+	while ((n = std::fread(buffer, 1, sizeof buffer, stdin)) > 0) {
+		source.append(buffer, n);
+	}
+
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	std::string path(argv[1]);
+	if (path.size() >= sizeof address.sun_path) {
+		std::cerr << "Socket path too long: " << path << std::endl;
+		return 2;
+	}
+	path.copy(address.sun_path, path.size());
+	auto server = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server < 0 || connect(server, reinterpret_cast<sockaddr*>(&address), sizeof address) < 0) {
+		std::cerr << "Can't connect to " << path << ": " << std::strerror(errno) << std::endl;
+		return 2;
+	}
+
+	/* The options go out together with our stdout and stderr */
+	int fds[2] = {1, 2};
+	char control[CMSG_SPACE(sizeof fds)] = {};
+	iovec iov{&options[0], options.size()};
+	msghdr message{};
+	message.msg_iov = &iov;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = sizeof control;
+	auto header = CMSG_FIRSTHDR(&message);
+	header->cmsg_level = SOL_SOCKET;
+	header->cmsg_type = SCM_RIGHTS;
+	header->cmsg_len = CMSG_LEN(sizeof fds);
+	std::memcpy(CMSG_DATA(header), fds, sizeof fds);
+	if (sendmsg(server, &message, 0) != static_cast<ssize_t>(options.size()) || !writeAll(server, source.data(), source.size())) {
+		std::cerr << "Can't send the request: " << std::strerror(errno) << std::endl;
+		return 2;
+	}
+	shutdown(server, SHUT_WR);
+
+	std::string reply;
+	ssize_t r;
+	while ((r = read(server, buffer, sizeof buffer)) > 0) {
+		reply.append(buffer, r);
+	}
+	close(server);
+	if (reply.compare(0, 5, "exit ") != 0) {
+		std::cerr << "The server closed the connection" << std::endl;
+		return 2;
+	}
+	return std::atoi(reply.c_str() + 5);
+}
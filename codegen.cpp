@@ -1,60 +1,285 @@
 #include "node.h"
 #include "codegen.h"
 #include "parser.hpp"
+#include "runtime.h"
+#include "deadcode.h"
+#include "inliner.h"
+#include "typecheck.h"
 #include <llvm/IR/IRPrintingPasses.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+#include <llvm/Support/CachePruning.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
 #include <llvm/Support/raw_os_ostream.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <functional>
+#include <limits>
 #include <set>
 
+void createCoreFunctions(CodeGenContext& context);
+
 /* Compile the AST into a module */
-void CodeGenContext::generateCode(NBlock& root)
+void CodeGenContext::generateCode(NBlock& root, const std::string& entry)
 {
 	dclog << debug_stream::info << "Generating code..." << std::endl;
+	prepareTree(root);
+
+	std::set<NStatement*> generated;
+	if (separateFunctions) {
+		generateUnits(root, generated);
+	}
 
 	/* Create the top level interpreter function to call as entry */
 	std::vector<Type*> argTypes;
 	auto ftype = FunctionType::get(Type::getInt64Ty(llvmContext), makeArrayRef(argTypes), false);
-	mainFunction = Function::Create(ftype, GlobalValue::ExternalLinkage, "main", module);
+	mainFunction = Function::Create(ftype, GlobalValue::ExternalLinkage, entry, module);
 	auto bblock = BasicBlock::Create(llvmContext, "entry", mainFunction, nullptr);
 
 	/* Push a new variable/block context */
 	pushBlock(bblock, "main");
-	root.codeGen(*this); /* emit bytecode for the toplevel block */
+	if (incremental) {
+		/* Remember which statement is top-level so its definitions outlive this module */
+		importPersistentSymbols();
+		for (auto statement : root.statements) {
+			topLevelStatement = statement;
+			auto value = statement->codeGen(*this);
+			if (echoResults) echoResult(*statement, value);
+		}
+		topLevelStatement = nullptr;
+	} else if (separateFunctions) {
+		importPersistentSymbols();
+		for (auto statement : root.statements) {
+			if (!generated.count(statement)) statement->codeGen(*this);
+		}
+	} else {
+		root.codeGen(*this); /* emit bytecode for the toplevel block */
+	}
 	if (!getCurrentReturnValue()) {
-		ReturnInst::Create(llvmContext, ConstantInt::get(Type::getInt64Ty(llvmContext), 0), currentBlock());
+		builder.CreateRet(ConstantInt::get(Type::getInt64Ty(llvmContext), 0));
 	} else {
 		if (getCurrentReturnValue()->getType() != Type::getInt64Ty(llvmContext)) {
 			std::cerr << "Main must return Int64!" << std::endl;
-			exit(0);
+			fail();
 		}
-		ReturnInst::Create(llvmContext, getCurrentReturnValue(), currentBlock());
+		builder.CreateRet(getCurrentReturnValue());
 	}
 	popBlockUntil(bblock);
 	popBlock();
+	linkBuiltins();
 
 	/* Print the bytecode in a human-readable format 
 	   to see if our program compiled properly
 	 */
 	dclog << debug_stream::info << "Code is generated." << std::endl;
+	if (!dumpModule) return;
 	PassManager<Module> pm;
 	AnalysisManager<Module> am;
 	pm.addPass(PrintModulePass(outs()));
+	for (auto unit : units) {
+		pm.run(*unit, am);
+	}
 	pm.run(*module, am);
 }
 
+/* Echoes the value of statement if it is an expression of type int, double or bool. A call to echo or echod
+   has shown its value already. */
+void CodeGenContext::echoResult(NStatement& statement, Value* value)
+{
+	auto expression = dyn_cast<NExpressionStatement>(&statement);
+	if (!expression || !value) return;
+	auto call = dyn_cast<NMethodCall>(expression->expression);
+	if (call && (call->id.name == "echo" || call->id.name == "echod")) return;
+	auto type = expression->expression->type;
+	auto int64 = Type::getInt64Ty(llvmContext);
+	auto output = Type::getVoidTy(llvmContext);
+	if (type == int64) {
+		builder.CreateCall(module->getOrInsertFunction("toy_echo_i64", output, int64), {value});
+	} else if (type == Type::getDoubleTy(llvmContext)) {
+		builder.CreateCall(module->getOrInsertFunction("toy_echo_f64", output, type), {value});
+	} else if (type == Type::getInt1Ty(llvmContext)) {
+		builder.CreateCall(module->getOrInsertFunction("toy_echo_bool", output, int64), {builder.CreateZExt(value, int64)});
+	}
+}
+
+void CodeGenContext::prepareTree(NBlock& root)
+{
+	/* Analyses run over the flat form, which the AST cache may have handed over already */
+	if (!ast.contains(&root)) {
+		ast.clear();
+		ast.indexOf(&root);
+	}
+
+	/* Inlining, dropping functions and types rewrite the tree, the flat form has to follow */
+	if (inlineCalls(root, *this)) {
+		ast.clear();
+		ast.indexOf(&root);
+	}
+	auto removed = removeDeadFunctions(root, *this);
+	if (assignTypes(root, *this) || removed) {
+		ast.clear();
+		ast.indexOf(&root);
+	}
+}
+
+/* Reads the builtins bitcode once, every module links in the definitions it uses */
+bool CodeGenContext::loadBuiltins(const std::string& path)
+{
+	auto buffer = MemoryBuffer::getFile(path);
+	if (!buffer) {
+		dclog << debug_stream::warn << "Builtins are called out of line, can't load " << path << ": " << buffer.getError().message() << std::endl;
+		return false;
+	}
+	MD5 hash;
+	hash.update((*buffer)->getBuffer());
+	MD5::MD5Result digest;
+	hash.final(digest);
+	builtinsHash = digest.digest().str().str();
+	SMDiagnostic err;
+	builtins = parseIR((*buffer)->getMemBufferRef(), err, llvmContext);
+	if (!builtins) {
+		builtinsHash.clear();
+		dclog << debug_stream::warn << "Builtins are called out of line, can't load " << path << ": " << err.getMessage().str() << std::endl;
+		return false;
+	}
+	for (auto& f : *builtins) {
+		if (f.isDeclaration()) continue;
+		f.removeFnAttr(Attribute::NoInline);
+		f.removeFnAttr(Attribute::OptimizeNone);
+		f.addFnAttr(Attribute::AlwaysInline);
+	}
+	dclog << debug_stream::info << "Loaded builtins from " << path << std::endl;
+	return true;
+}
+
+/* Copies the builtins the module calls into it, internalized so each module owns its copy */
+void CodeGenContext::linkBuiltins()
+{
+	if (!builtins) return;
+	auto internalize = [](Module& m, const StringSet<>& linked) {
+		for (auto const& name : linked) {
+			if (auto gv = m.getNamedValue(name.first())) gv->setLinkage(GlobalValue::InternalLinkage);
+		}
+	};
+	if (Linker::linkModules(*module, CloneModule(*builtins), Linker::LinkOnlyNeeded, internalize)) {
+		std::cerr << "Can't link builtins" << std::endl;
+		exit(1);
+	}
+}
+
+/* Runs the -O3 pipeline, including the loop and SLP vectorizers, over the module */
+void CodeGenContext::optimizeModule(TargetMachine& tm, Module& m)
+{
+	dclog << debug_stream::info << "Optimizing code..." << std::endl;
+	m.setTargetTriple(tm.getTargetTriple().str());
+	m.setDataLayout(tm.createDataLayout());
+
+	PassManagerBuilder pmb;
+	pmb.OptLevel = 3;
+	pmb.LoopVectorize = true;
+	pmb.SLPVectorize = true;
+	pmb.Inliner = createFunctionInliningPass(3, 0, false);
+	tm.adjustPassManager(pmb);
+
+	legacy::FunctionPassManager fpm(&m);
+	legacy::PassManager mpm;
+	fpm.add(createTargetTransformInfoWrapperPass(tm.getTargetIRAnalysis()));
+	mpm.add(createTargetTransformInfoWrapperPass(tm.getTargetIRAnalysis()));
+	pmb.populateFunctionPassManager(fpm);
+	pmb.populateModulePassManager(mpm);
+
+	fpm.doInitialization();
+	for (auto& f : m) {
+		fpm.run(f);
+	}
+	fpm.doFinalization();
+	mpm.run(m);
+	dclog << debug_stream::info << "Code is optimized." << std::endl;
+}
+
 /* Executes the AST by running the main function */
 GenericValue CodeGenContext::runCode()
 {
 	dclog << debug_stream::info << "Running code..." << std::endl;
-	auto ee = EngineBuilder(std::unique_ptr<Module>(module)).setOptLevel(CodeGenOpt::Aggressive).create();
+	EngineBuilder engineBuilder{std::unique_ptr<Module>(module)};
+	engineBuilder.setOptLevel(CodeGenOpt::Aggressive);
+	engineBuilder.setMCPU(sys::getHostCPUName());
+	auto tm = engineBuilder.selectTarget();
+	if (optimize) {
+		/* A cached object is already optimized, the pipeline would only be thrown away */
+		if (!objectCache || !objectCache->contains(module->getModuleIdentifier())) optimizeModule(*tm, *module);
+		for (auto unit : units) {
+			if (!objectCache || !objectCache->contains(unit->getModuleIdentifier())) optimizeModule(*tm, *unit);
+		}
+	}
+	auto ee = engineBuilder.create(tm);
+	for (auto unit : units) {
+		ee->addModule(std::unique_ptr<Module>(unit));
+	}
+	units.clear();
+	if (objectCache) {
+		ee->setObjectCache(objectCache);
+	}
 	ee->finalizeObject();
 	std::vector<GenericValue> noargs;
 	auto v = ee->runFunction(mainFunction, noargs);
+	toy_flush_output();
 	dclog << debug_stream::info << "Code was run." << std::endl;
 	return v;
 }
 
+std::string ObjectFileCache::pathOf(const std::string& identifier) const
+{
+	/* pruneCache only looks at files named like this */
+	SmallString<128> path(directory);
+	sys::path::append(path, "llvmcache-" + identifier + ".o");
+	return path.str().str();
+}
+
+void ObjectFileCache::prune(const std::string& directory)
+{
+	CachePruningPolicy policy;
+	policy.Expiration = std::chrono::hours(7 * 24);
+	policy.MaxSizeBytes = uint64_t(512) << 20;
+	pruneCache(directory, policy);
+}
+
+bool ObjectFileCache::contains(const std::string& identifier) const
+{
+	return sys::fs::exists(pathOf(identifier));
+}
+
+void ObjectFileCache::notifyObjectCompiled(const Module* module, MemoryBufferRef object)
+{
+	/* Compilers may share the directory, so write aside and rename: nobody reads half an object */
+	auto path = pathOf(module->getModuleIdentifier());
+	auto temporary = path + "." + std::to_string(sys::Process::getProcessId());
+	std::error_code ec;
+	raw_fd_ostream out(temporary, ec, sys::fs::OF_None);
+	if (ec) return;
+	out << object.getBuffer();
+	out.close();
+	sys::fs::rename(temporary, path);
+}
+
+std::unique_ptr<MemoryBuffer> ObjectFileCache::getObject(const Module* module)
+{
+	auto buffer = MemoryBuffer::getFile(pathOf(module->getModuleIdentifier()));
+	if (!buffer) return nullptr;
+	return std::move(*buffer);
+}
+
 /* Returns an LLVM type based on the identifier */
-static Type* typeOf(const NIdentifier& type, CodeGenContext& context)
+Type* typeOf(const NIdentifier& type, CodeGenContext& context)
 {
 	if (type.name.compare("int") == 0) {
 		return Type::getInt64Ty(context.llvmContext);
@@ -65,6 +290,9 @@ static Type* typeOf(const NIdentifier& type, CodeGenContext& context)
 	if (type.name.compare("bool") == 0) {
 		return Type::getInt1Ty(context.llvmContext);
 	}
+	if (type.name.size() > 2 && type.name.compare(type.name.size() - 2, 2, "[]") == 0) {
+		return context.arrayType(typeOf(NIdentifier(type.name.substr(0, type.name.size() - 2)), context));
+	}
 	return Type::getVoidTy(context.llvmContext);
 }
 
@@ -72,21 +300,19 @@ static inline Value* cast(Value* op, Type* dest, CodeGenContext& context)
 {
 	if (op->getType() == Type::getInt64Ty(context.llvmContext) && dest == Type::getDoubleTy(context.llvmContext)) {
 		//Int64 -> Double
-		return new SIToFPInst(op, dest, "", context.currentBlock());
+		return context.builder.CreateSIToFP(op, dest);
 	}
 	if (op->getType() == Type::getDoubleTy(context.llvmContext) && dest == Type::getInt64Ty(context.llvmContext)) {
 		//Double -> Int64
-		return new FPToSIInst(op, dest, "", context.currentBlock());
+		return context.builder.CreateFPToSI(op, dest);
 	}
 	if (op->getType() == Type::getInt64Ty(context.llvmContext) && dest == Type::getInt1Ty(context.llvmContext)) {
 		//Int64 -> Boolean
-		return ICmpInst::Create(Instruction::ICmp, ICmpInst::Predicate::ICMP_NE, op, ConstantInt::get(Type::getInt64Ty(context.llvmContext), 0),
-		                        "", context.currentBlock());
+		return context.builder.CreateICmpNE(op, ConstantInt::get(Type::getInt64Ty(context.llvmContext), 0));
 	}
 	if (op->getType() == Type::getDoubleTy(context.llvmContext) && dest == Type::getInt1Ty(context.llvmContext)) {
 		//Double -> Boolean
-		return FCmpInst::Create(Instruction::FCmp, ICmpInst::Predicate::FCMP_ONE, op, ConstantFP::get(Type::getDoubleTy(context.llvmContext), 0.0),
-		                        "", context.currentBlock());
+		return context.builder.CreateFCmpONE(op, ConstantFP::get(Type::getDoubleTy(context.llvmContext), 0.0));
 	}
 	llvm_unreachable("Invaild cast!");
 }
@@ -100,33 +326,262 @@ static inline Value* castToIfNeed(Value* op, Type* dest, CodeGenContext& context
 	return res;
 }
 
-static inline Value* castDouble(Value* op, CodeGenContext& context)
+/* Builds an llvm.loop node from hints such as vectorize.enable or unroll.count */
+static MDNode* loopMetadata(CodeGenContext& context, const std::map<std::string, int64_t>& hints)
 {
-	return castToIfNeed(op, Type::getDoubleTy(context.llvmContext), context);
+	std::vector<Metadata*> ops;
+	auto self = MDNode::getTemporary(context.llvmContext, None);
+	ops.push_back(self.get());
+	for (auto const& hint : hints) {
+		auto type = hint.first.find(".enable") != std::string::npos ? Type::getInt1Ty(context.llvmContext) : Type::getInt32Ty(context.llvmContext);
+		Metadata* hintOps[] = {
+			MDString::get(context.llvmContext, "llvm.loop." + hint.first),
+			ConstantAsMetadata::get(ConstantInt::get(type, hint.second))
+		};
+		ops.push_back(MDNode::get(context.llvmContext, hintOps));
+	}
+	auto loopID = MDNode::get(context.llvmContext, makeArrayRef(ops));
+	loopID->replaceOperandWith(0, loopID);
+	return loopID;
+}
+
+/* Emits for (iv = 0; iv < tripCount; ++iv) body(iv) with a single phi induction variable, the trip count is unsigned */
+static void emitCountedLoop(CodeGenContext& context, Value* tripCount, MDNode* loopID, const std::function<void(Value*)>& body)
+{
+	auto int64 = Type::getInt64Ty(context.llvmContext);
+	auto iff = context.currentBlock()->getParent();
+	auto preheader = context.currentBlock();
+	auto loop_bb = BasicBlock::Create(context.llvmContext, context.trace() + "loop", iff);
+	auto body_bb = BasicBlock::Create(context.llvmContext, context.trace() + "body", iff);
+	auto exit_bb = BasicBlock::Create(context.llvmContext, context.trace() + "done", iff);
+	context.builder.CreateBr(loop_bb);
+
+	context.pushBlock(loop_bb, "loop", true);
+	auto iv = context.builder.CreatePHI(int64, 2, "iv");
+	iv->addIncoming(ConstantInt::get(int64, 0), preheader);
+	auto CondInst = context.builder.CreateICmpULT(iv, tripCount, "cond");
+	context.builder.CreateCondBr(CondInst, body_bb, exit_bb);
+
+	context.pushBlock(body_bb, "body", true);
+	body(iv);
+	auto next = context.builder.CreateAdd(iv, ConstantInt::get(int64, 1), "iv.next", true);
+	auto latch = context.builder.CreateBr(loop_bb);
+	if (loopID) latch->setMetadata(LLVMContext::MD_loop, loopID);
+	iv->addIncoming(next, context.currentBlock());
+	context.popBlockUntil(body_bb);
+	context.popBlock();
+	context.popBlockUntil(loop_bb);
+	context.popBlock();
+
+	context.pushBlock(exit_bb, "done", true);
 }
 
-static inline Value* castInt64(Value* op, CodeGenContext& context)
+/* Whether running node defines an array whose length is only known at run time, which takes stack space
+   every time. Loops around such code save the stack pointer on every iteration and restore it at the end. */
+static bool saveStackIn(Node& node, CodeGenContext& context)
 {
-	return castToIfNeed(op, Type::getInt64Ty(context.llvmContext), context);
+	auto& ast = context.ast;
+	auto index = ast.indexOf(&node);
+	for (auto i = ast.starts[index]; i <= index; ++i) {
+		if (ast.tags[i] == NodeKind::ArrayDefinition && ast.tags[ast.operandsOf(i)[2]] != NodeKind::Integer) return true;
+	}
+	return false;
 }
 
-static inline Value* castBoolean(Value* op, CodeGenContext& context)
+static Value* stackSave(CodeGenContext& context)
 {
-	return castToIfNeed(op, Type::getInt1Ty(context.llvmContext), context);
+	return context.builder.CreateCall(Intrinsic::getDeclaration(context.module, Intrinsic::stacksave), {}, "stack");
 }
 
-int64_t NBool::getValue()
+static void stackRestore(Value* saved, CodeGenContext& context)
 {
-	return static_cast<int64_t>(value);
+	context.builder.CreateCall(Intrinsic::getDeclaration(context.module, Intrinsic::stackrestore), {saved});
 }
 
-int64_t NInteger::getValue()
+/* Loads the header of the array named by id, exits if it's not an array */
+static Value* findArray(const NIdentifier& id, CodeGenContext& context)
 {
-	return value;
+	Value* loc;
+	if (!((loc = context.find_locals(id.name)))) {
+		std::cerr << "undeclared variable " << id.name << std::endl;
+		context.fail();
+	}
+	/* A let is bound to the header itself */
+	auto bound = !loc->getType()->isPointerTy();
+	auto headerType = bound ? loc->getType() : loc->getType()->getPointerElementType();
+	if (!context.arrayElementType(headerType)) {
+		std::cerr << id.name << " is not an array" << std::endl;
+		context.fail();
+	}
+	return bound ? loc : context.builder.CreateLoad(headerType, loc, id.name);
+}
+
+/* Goes on in a block of its own if ok holds, otherwise calls the runtime function error with a and b,
+   which reports the failed check and doesn't return */
+static void checkOrReport(Value* ok, const char* error, Value* a, Value* b, CodeGenContext& context)
+{
+	auto int64 = Type::getInt64Ty(context.llvmContext);
+	auto iff = context.currentBlock()->getParent();
+	auto ok_bb = BasicBlock::Create(context.llvmContext, context.trace() + "ok", iff);
+	auto fail_bb = BasicBlock::Create(context.llvmContext, context.trace() + "fail", iff);
+	context.builder.CreateCondBr(ok, ok_bb, fail_bb);
+
+	auto report = context.module->getOrInsertFunction(error, Type::getVoidTy(context.llvmContext), int64, int64);
+	if (auto function = dyn_cast<Function>(report.getCallee())) {
+		function->addFnAttr(Attribute::NoReturn);
+		function->addFnAttr(Attribute::Cold);
+	}
+	IRBuilder<> fail(fail_bb);
+	fail.CreateCall(report, {a, b});
+	fail.CreateUnreachable();
+
+	context.pushBlock(ok_bb, "ok", true);
+}
+
+static Value* elementPointer(const NIdentifier& id, NExpression* index, CodeGenContext& context)
+{
+	auto header = findArray(id, context);
+	auto elementType = context.arrayElementType(header->getType());
+	auto idx = index->codeGen(context);
+	auto length = context.builder.CreateExtractValue(header, 0, id.name + ".len");
+	/* Unsigned, so a negative index is out of bounds as well */
+	checkOrReport(context.builder.CreateICmpULT(idx, length, "inbounds"), "toy_index_error", idx, length, context);
+	auto data = context.builder.CreateExtractValue(header, 1, id.name + ".data");
+	return context.builder.CreateInBoundsGEP(elementType, data, idx);
+}
+
+/* One leaf of an element-wise expression: a whole array, or a scalar broadcast to every element */
+struct ElementOperand
+{
+	Value* length = nullptr;
+	Value* data = nullptr;
+	Value* scalar = nullptr;
+};
+
+static bool isArrayValued(NExpression& expr, CodeGenContext& context)
+{
+	return expr.type && context.arrayElementType(expr.type);
+}
+
+/* Evaluates every leaf once, ahead of the loop */
+static void prepareElementwise(NExpression& expr, Type* elementType, std::map<NExpression*, ElementOperand>& operands, CodeGenContext& context)
+{
+	auto binop = dyn_cast<NBinaryOperator>(&expr);
+	if (binop && isArrayValued(expr, context)) {
+		prepareElementwise(*binop->lhs, elementType, operands, context);
+		prepareElementwise(*binop->rhs, elementType, operands, context);
+		return;
+	}
+	auto value = expr.codeGen(context);
+	ElementOperand operand;
+	if (context.arrayElementType(value->getType())) {
+		operand.length = context.builder.CreateExtractValue(value, 0, "len");
+		operand.data = context.builder.CreateExtractValue(value, 1, "data");
+	} else {
+		operand.scalar = castToIfNeed(value, elementType, context);
+	}
+	operands[&expr] = operand;
+}
+
+static Value* emitElement(NExpression& expr, Value* index, Type* elementType, std::map<NExpression*, ElementOperand>& operands, CodeGenContext& context)
+{
+	auto found = operands.find(&expr);
+	if (found != operands.end()) {
+		if (found->second.scalar) {
+			return found->second.scalar;
+		}
+		auto sourceType = found->second.data->getType()->getPointerElementType();
+		auto element = context.builder.CreateLoad(sourceType, context.builder.CreateInBoundsGEP(sourceType, found->second.data, index));
+		return castToIfNeed(element, elementType, context);
+	}
+	auto& binop = static_cast<NBinaryOperator&>(expr);
+	auto lhs_v = emitElement(*binop.lhs, index, elementType, operands, context);
+	auto rhs_v = emitElement(*binop.rhs, index, elementType, operands, context);
+	auto fp = elementType->isDoubleTy();
+	switch (binop.op) {
+	case TPLUS:
+		return context.builder.CreateBinOp(fp ? Instruction::FAdd : Instruction::Add, lhs_v, rhs_v);
+	case TMINUS:
+		return context.builder.CreateBinOp(fp ? Instruction::FSub : Instruction::Sub, lhs_v, rhs_v);
+	case TMUL:
+		return context.builder.CreateBinOp(fp ? Instruction::FMul : Instruction::Mul, lhs_v, rhs_v);
+	default:
+		return context.builder.CreateBinOp(fp ? Instruction::FDiv : Instruction::SDiv, lhs_v, rhs_v);
+	}
+}
+
+/* Stores rhs into every element of the array at header, as one fused, vectorizable loop. Every array in rhs
+   must be as long as the destination, which is checked once ahead of the loop.
+   Arithmetic is done in the element type of the destination. */
+static Value* assignElementwise(Value* header, NExpression& rhs, CodeGenContext& context)
+{
+	auto headerType = header->getType()->getPointerElementType();
+	auto elementType = context.arrayElementType(headerType);
+	auto dest = context.builder.CreateLoad(headerType, header);
+	auto length = context.builder.CreateExtractValue(dest, 0, "len");
+	auto data = context.builder.CreateExtractValue(dest, 1, "data");
+
+	std::map<NExpression*, ElementOperand> operands;
+	prepareElementwise(rhs, elementType, operands, context);
+	for (auto const& operand : operands) {
+		if (operand.second.length) {
+			auto same = context.builder.CreateICmpEQ(operand.second.length, length, "samelen");
+			checkOrReport(same, "toy_length_error", operand.second.length, length, context);
+		}
+	}
+
+	std::map<std::string, int64_t> hints;
+	hints["vectorize.enable"] = 1;
+	emitCountedLoop(context, length, loopMetadata(context, hints), [&](Value* iv) {
+		auto value = emitElement(rhs, iv, elementType, operands, context);
+		context.builder.CreateStore(value, context.builder.CreateInBoundsGEP(elementType, data, iv));
+	});
+	return dest;
+}
+
+int64_t NValue::getValue()
+{
+	if (auto boolean = dyn_cast<NBool>(this)) {
+		return static_cast<int64_t>(boolean->value);
+	}
+	return cast<NInteger>(this)->value;
+}
+
+const char* nodeKindName(NodeKind kind)
+{
+	static const char* const names[] = {
+		"bool", "integer", "double", "identifier", "method call", "binary operator", "assignment",
+		"array index", "array assignment", "array length", "block", "expression statement", "return",
+		"if", "while", "for", "parallel for", "variable definition", "array definition", "extern",
+		"function", "variable declaration", "cast", "match"
+	};
+	return names[static_cast<size_t>(kind)];
 }
 
 /* -- Code Generation -- */
 
+namespace
+{
+	/* Every kind goes to the codeGen of its own class */
+	class CodeGenDispatch : public NodeVisitor<CodeGenDispatch, Value*>
+	{
+		CodeGenContext& context;
+
+	public:
+		explicit CodeGenDispatch(CodeGenContext& context) : context(context) { }
+
+		template <typename T>
+		Value* visitNode(T& node) { return node.codeGen(context); }
+
+		Value* visitVariableDeclaration(NVariableDeclaration&) { return nullptr; }
+	};
+}
+
+Value* Node::codeGen(CodeGenContext& context)
+{
+	return CodeGenDispatch(context).visit(*this);
+}
+
 Value* NBool::codeGen(CodeGenContext& context)
 {
 	context.dclog << debug_stream::info << "Creating boolean: " << value << std::endl;
@@ -151,14 +606,18 @@ Value* NIdentifier::codeGen(CodeGenContext& context)
 	Value* loc;
 	if (!((loc = context.find_locals(name)))) {
 		std::cerr << "undeclared variable " << name << std::endl;
-		exit(1);
+		context.fail();
 	}
-	return new LoadInst(loc, "", false, context.currentBlock());
+	if (!loc->getType()->isPointerTy()) {
+		/* Bound with let, or captured by value */
+		return loc;
+	}
+	return context.builder.CreateLoad(loc->getType()->getPointerElementType(), loc);
 }
 
 Value* NMethodCall::codeGen(CodeGenContext& context)
 {
-	auto function = context.module->getFunction(id.name.c_str());
+	auto function = context.findFunction(id.name);
 	if (function == nullptr) {
 		auto loc = context.find_locals(context.ftrace() + "__fn_" + id.name);
 		if (loc) context.dclog << debug_stream::info << "Finding local function: " << id.name << std::endl;
@@ -166,7 +625,7 @@ Value* NMethodCall::codeGen(CodeGenContext& context)
 			function = static_cast<Function*>(loc);
 		} else {
 			std::cerr << "No such function " << id.name << std::endl;
-			exit(1);
+			context.fail();
 		}
 	}
 	context.dclog << "Creating method call: " << id.name << std::endl;
@@ -184,34 +643,111 @@ Value* NMethodCall::codeGen(CodeGenContext& context)
 			(context.llclog << "\n").flush();
 		}
 	}
-	for (auto ex : context.extra[context.ftrace() + "__fn_" + id.name]) {
-		context.dclog << "Generating code for extra" << i << std::endl;
-		auto val = context.find_locals(ex);
-		context.dclog << "arg" << i++ << "'s type: " << std::flush;
-		if (context.dclog.max_level >= debug_stream::info) {
-			val->getType()->print(context.llclog);
-			(context.llclog << "\n").flush();
+	auto& captures = context.extra[context.ftrace() + "__fn_" + id.name];
+	if (!captures.empty() && function->arg_size() > arguments.size()) {
+		/* The captures go in the environment of the callee, filled here and passed as one pointer */
+		auto envType = cast<StructType>(function->getFunctionType()->getParamType(i)->getPointerElementType());
+		auto env = context.entryAlloca(envType, "env." + id.name);
+		for (unsigned field = 0; field < envType->getNumElements(); ++field) {
+			auto ex = captures[field];
+			context.dclog << "Generating code for capture " << ex << std::endl;
+			auto val = context.find_locals(ex);
+			auto fieldType = envType->getElementType(field);
+			if (!fieldType->isPointerTy() && val->getType()->isPointerTy()) {
+				/* The callee never writes it, so it gets the value */
+				val = context.builder.CreateLoad(fieldType, val, ex);
+			}
+			context.builder.CreateStore(val, context.builder.CreateStructGEP(envType, env, field));
 		}
-		args.push_back(val);
+		args.push_back(env);
 	}
 	context.dclog << debug_stream::indent(2, -1);
+	if (context.externs.count(function->getName().str())) {
+		/* What this thread echoed so far goes out first, in case the function writes to stdout too */
+		context.builder.CreateCall(context.module->getOrInsertFunction("toy_flush_echoes", Type::getVoidTy(context.llvmContext)));
+	}
+
+	return context.builder.CreateCall(function, makeArrayRef(args));
+}
+
+/* Adds the nodes of expr to cost, false if evaluating it when its branch is not taken could go wrong or be
+   seen: calls, stores, array elements and integer divisions that may trap */
+static bool speculatable(NExpression& expr, unsigned& cost)
+{
+	++cost;
+	switch (expr.kind) {
+	case NodeKind::Integer:
+	case NodeKind::Double:
+	case NodeKind::Bool:
+	case NodeKind::Identifier:
+		return true;
+	case NodeKind::Cast:
+		return speculatable(*cast<NCast>(expr).expression, cost);
+	case NodeKind::BinaryOperator: {
+		auto& binary = cast<NBinaryOperator>(expr);
+		if (binary.op == TPOW) return false;
+		if (binary.op == TDIV && binary.lhs->type && binary.lhs->type->isIntegerTy()) {
+			auto divisor = dyn_cast<NInteger>(binary.rhs);
+			if (!divisor || divisor->value == 0 || divisor->value == -1) return false;
+		}
+		return speculatable(*binary.lhs, cost) && speculatable(*binary.rhs, cost);
+	}
+	default:
+		return false;
+	}
+}
+
+/* && and || only run their rhs when the lhs doesn't decide, unless it is cheap enough to evaluate anyway */
+static Value* shortCircuit(NBinaryOperator& node, Value* lhs_v, CodeGenContext& context)
+{
+	auto isAnd = node.op == TAND;
+	auto name = isAnd ? "and" : "or";
+	auto decided = ConstantInt::get(Type::getInt1Ty(context.llvmContext), isAnd ? 0 : 1);
+	unsigned cost = 0;
+	if (speculatable(*node.rhs, cost) && cost <= context.selectThreshold) {
+		auto rhs_v = node.rhs->codeGen(context);
+		return isAnd ? context.builder.CreateSelect(lhs_v, rhs_v, decided, name) : context.builder.CreateSelect(lhs_v, decided, rhs_v, name);
+	}
+
+	auto iff = context.currentBlock()->getParent();
+	auto lhs_bb = context.builder.GetInsertBlock();
+	auto rhs_bb = BasicBlock::Create(context.llvmContext, context.trace() + name, iff);
+	auto merge_bb = BasicBlock::Create(context.llvmContext, context.trace() + "merge", iff);
+	if (isAnd) {
+		context.builder.CreateCondBr(lhs_v, rhs_bb, merge_bb);
+	} else {
+		context.builder.CreateCondBr(lhs_v, merge_bb, rhs_bb);
+	}
+
+	context.pushBlock(rhs_bb, name, true);
+	auto rhs_v = node.rhs->codeGen(context);
+	auto rhs_end = context.builder.GetInsertBlock();
+	context.builder.CreateBr(merge_bb);
+	context.popBlockUntil(rhs_bb);
+	context.popBlock();
 
-	return CallInst::Create(function, makeArrayRef(args), "", context.currentBlock());
+	context.pushBlock(merge_bb, "merge", true);
+	auto value = context.builder.CreatePHI(Type::getInt1Ty(context.llvmContext), 2, name);
+	value->addIncoming(decided, lhs_bb);
+	value->addIncoming(rhs_v, rhs_end);
+	return value;
 }
 
 Value* NBinaryOperator::codeGen(CodeGenContext& context)
 {
 	context.dclog << debug_stream::info << "Creating binary operation " << op << std::endl;
 	Instruction::BinaryOps instr;
-	Instruction::OtherOps cmpinstr;
-	ICmpInst::Predicate pred;
+	CmpInst::Predicate pred;
 	context.dclog << "Generating lhs" << std::endl;
 	context.dclog << debug_stream::indent(2, +1);
-	auto lhs_v = lhs.codeGen(context);
+	auto lhs_v = lhs->codeGen(context);
 	context.dclog << debug_stream::info << debug_stream::indent(2, -1);
+	if (op == TAND || op == TOR) {
+		return shortCircuit(*this, lhs_v, context);
+	}
 	context.dclog << "Generating rhs" << std::endl;
 	context.dclog << debug_stream::indent(2, +1);
-	auto rhs_v = rhs.codeGen(context);
+	auto rhs_v = rhs->codeGen(context);
 	context.dclog << debug_stream::info << debug_stream::indent(2, -1) << "The operands' types are " << std::flush;
 	if (context.dclog.max_level >= debug_stream::info) {
 		lhs_v->getType()->print(context.llclog);
@@ -219,9 +755,11 @@ Value* NBinaryOperator::codeGen(CodeGenContext& context)
 		rhs_v->getType()->print(context.llclog);
 		(context.llclog << "\n").flush();
 	}
-	//Int64 operands
-	if (lhs_v->getType() == Type::getInt64Ty(context.llvmContext) && rhs_v->getType() == Type::getInt64Ty(context.llvmContext)) {
-		cmpinstr = Instruction::ICmp;
+	if (op == TNOT) {
+		return context.builder.CreateNot(lhs_v);
+	}
+	//Int64 operands, otherwise the checker has made both double
+	if (lhs->type == Type::getInt64Ty(context.llvmContext)) {
 		switch (op) {
 		case TPLUS:
 			instr = Instruction::Add;
@@ -259,30 +797,18 @@ Value* NBinaryOperator::codeGen(CodeGenContext& context)
 			llvm_unreachable("Error binop used");
 
 		case TPOW:
-			std::vector<Value *> arg;
-
-			auto lhs_v_d = castDouble(lhs_v, context);
-			auto rhs_v_d = castDouble(rhs_v, context);
-			arg.push_back(lhs_v_d);
-			arg.push_back(rhs_v_d);
-
-			auto fun = context.globalFun.at("pow");
-			auto res_D = CallInst::Create(fun, makeArrayRef(arg), "llvm.pow.f64", context.currentBlock());
-			return castInt64(res_D, context);
+			auto int64 = Type::getInt64Ty(context.llvmContext);
+			auto fun = context.module->getOrInsertFunction("toy_pow_i64", int64, int64, int64);
+			return context.builder.CreateCall(fun, {lhs_v, rhs_v}, "pow");
 		}
 
 	math:
-		return BinaryOperator::Create(instr, lhs_v, rhs_v,
-		                              "", context.currentBlock());
+		return context.builder.CreateBinOp(instr, lhs_v, rhs_v);
 	cmp:
-		return ICmpInst::Create(cmpinstr, pred, lhs_v, rhs_v,
-		                        "", context.currentBlock());
+		return context.builder.CreateICmp(pred, lhs_v, rhs_v);
 
 	}
-	if (lhs_v->getType() == Type::getDoubleTy(context.llvmContext) || rhs_v->getType() == Type::getDoubleTy(context.llvmContext)) {
-		auto lhs_v_d = castDouble(lhs_v, context);
-		auto rhs_v_d = castDouble(rhs_v, context);
-		cmpinstr = Instruction::FCmp;
+	{
 		switch (op) {
 		case TPLUS:
 			instr = Instruction::FAdd;
@@ -321,25 +847,18 @@ Value* NBinaryOperator::codeGen(CodeGenContext& context)
 		case TPOW:
 
 			std::vector<Value *> arg;
-			arg.push_back(lhs_v_d);
-			arg.push_back(rhs_v_d);
+			arg.push_back(lhs_v);
+			arg.push_back(rhs_v);
 			auto fun = context.globalFun.at("pow");
 
-			return CallInst::Create(fun, makeArrayRef(arg), "llvm.pow.f64", context.currentBlock());
+			return context.builder.CreateCall(fun, makeArrayRef(arg), "llvm.pow.f64");
 
 		}
 	mathd:
-		return BinaryOperator::Create(instr, lhs_v_d,
-		                              rhs_v_d, "", context.currentBlock());
+		return context.builder.CreateBinOp(instr, lhs_v, rhs_v);
 	cmpd:
-		return FCmpInst::Create(cmpinstr, pred, lhs_v_d, rhs_v_d,
-		                        "", context.currentBlock());
-	}
-	if (op != TNOT) {
-		std::cerr << "Error binop used" << std::endl;
-		exit(0);
+		return context.builder.CreateFCmp(pred, lhs_v, rhs_v);
 	}
-	return ConstantInt::get(Type::getInt1Ty(context.llvmContext), !(static_cast<NValue&>(rhs).getValue()));
 }
 
 Value* NAssignment::codeGen(CodeGenContext& context)
@@ -349,10 +868,41 @@ Value* NAssignment::codeGen(CodeGenContext& context)
 	Value* loc;
 	if (!((loc = context.find_locals(lhs.name)))) {
 		std::cerr << "undeclared variable " << lhs.name << std::endl;
-		exit(1);
+		context.fail();
+	}
+	if (context.arrayElementType(loc->getType()->getPointerElementType())) {
+		context.dclog << "Creating element-wise assignment for " << lhs.name << std::endl;
+		return assignElementwise(loc, *rhs, context);
 	}
-	auto val = rhs.codeGen(context);
-	return new StoreInst(val, loc, false, context.currentBlock());
+	auto val = rhs->codeGen(context);
+	return context.builder.CreateStore(val, loc);
+}
+
+Value* NArrayIndex::codeGen(CodeGenContext& context)
+{
+	context.dclog << debug_stream::info << "Creating array index for " << id.name << std::endl;
+	auto ptr = elementPointer(id, index, context);
+	return context.builder.CreateLoad(ptr->getType()->getPointerElementType(), ptr);
+}
+
+Value* NArrayAssignment::codeGen(CodeGenContext& context)
+{
+	context.dclog << debug_stream::info << "Creating array element assignment for " << id.name << std::endl;
+	auto ptr = elementPointer(id, index, context);
+	auto val = rhs->codeGen(context);
+	return context.builder.CreateStore(val, ptr);
+}
+
+Value* NArrayLength::codeGen(CodeGenContext& context)
+{
+	context.dclog << debug_stream::info << "Creating array length for " << id.name << std::endl;
+	return context.builder.CreateExtractValue(findArray(id, context), 0, id.name + ".len");
+}
+
+Value* NCast::codeGen(CodeGenContext& context)
+{
+	context.dclog << debug_stream::info << "Creating cast to " << target.name << std::endl;
+	return cast(expression->codeGen(context), type, context);
 }
 
 Value* NBlock::codeGen(CodeGenContext& context)
@@ -361,7 +911,7 @@ Value* NBlock::codeGen(CodeGenContext& context)
 	context.dclog << debug_stream::info << "Creating block " << this << std::endl;
 	context.dclog << debug_stream::indent(1, +1);
 	for (StatementList::const_iterator it = statements.begin(); it != statements.end(); ++it) {
-		context.dclog << debug_stream::info << "Generating code with " << typeid(**it).name() << " in " << this << std::endl;
+		context.dclog << debug_stream::info << "Generating code with " << nodeKindName((*it)->kind) << " in " << this << std::endl;
 		context.dclog << debug_stream::indent(1, +1);
 		last = (*it)->codeGen(context);
 		context.dclog << debug_stream::indent(1, -1);
@@ -373,15 +923,15 @@ Value* NBlock::codeGen(CodeGenContext& context)
 
 Value* NExpressionStatement::codeGen(CodeGenContext& context)
 {
-	context.dclog << "Generating code for " << typeid(expression).name() << std::endl;
-	return expression.codeGen(context);
+	context.dclog << "Generating code for " << nodeKindName(expression->kind) << std::endl;
+	return expression->codeGen(context);
 }
 
 Value* NReturnStatement::codeGen(CodeGenContext& context)
 {
-	context.dclog << debug_stream::info << "Generating return code in " << this << " with " << typeid(expression).name() << std::endl;
+	context.dclog << debug_stream::info << "Generating return code in " << this << " with " << nodeKindName(expression->kind) << std::endl;
 	context.dclog << debug_stream::indent(2, +1);
-	auto returnValue = expression.codeGen(context);
+	auto returnValue = expression->codeGen(context);
 	context.dclog << debug_stream::indent(2, -1);
 	context.dclog << debug_stream::info << "-Generated return code " << this << std::endl;
 
@@ -391,63 +941,56 @@ Value* NReturnStatement::codeGen(CodeGenContext& context)
 
 Value* NIfBlock::codeGen(CodeGenContext& context)
 {
-	std::vector<Type*> argTypes;
-	VariableList::const_iterator it;
 	context.dclog << debug_stream::info << "Creating if " << this << std::endl;
 	context.dclog << debug_stream::indent(1, +1);
 
-	auto ftype = FunctionType::get(Type::getVoidTy(context.llvmContext), makeArrayRef(argTypes), false);
-	auto fake = Function::Create(ftype, GlobalValue::InternalLinkage, "", context.module);
 	auto iff = context.currentBlock()->getParent();
 	auto bblock = BasicBlock::Create(context.llvmContext, context.trace() + "if", iff);
-	auto then_bb = BasicBlock::Create(context.llvmContext, context.trace() + "then", iff);
-	auto else_bb = BasicBlock::Create(context.llvmContext, context.trace() + "else", iff);
 	auto merge_bb = BasicBlock::Create(context.llvmContext, context.trace() + "merge", iff);
-	BranchInst::Create(bblock, context.currentBlock());
+	context.builder.CreateBr(bblock);
 
 	context.pushBlock(bblock, "if", true);
 	context.dclog << debug_stream::info << "Generating if condition in " << this << std::endl;
 	context.dclog << debug_stream::indent(2, +1);
-	auto vcond = castBoolean(cond.codeGen(context), context);
+	auto vcond = cond->codeGen(context);
 	context.dclog << debug_stream::indent(2, -1);
 	context.dclog << debug_stream::info << "-Generated if condition in " << this << std::endl;
+	auto CondInst = context.builder.CreateICmpNE(vcond, ConstantInt::get(Type::getInt1Ty(context.llvmContext), 0), "cond");
 
-
-	auto tmp = BasicBlock::Create(context.llvmContext, "tmp_" + context.trace(), fake);
-	context.dclog << debug_stream::info << "Start type infer in " << this << std::endl;
-	context.dclog << debug_stream::indent(2, +1);
-	context.pushBlock(tmp, "tmp", true);
-	auto thenType = thenblock.codeGen(context)->getType();
-	auto elseType = elseblock.codeGen(context)->getType();
-	context.popBlockUntil(tmp);
-	context.popBlock();
-	tmp->eraseFromParent();
-	fake->eraseFromParent();
-	context.dclog << debug_stream::indent(2, -1);
-	context.dclog << debug_stream::info << "-Finish type infer in " << this << std::endl;
-	if (context.dclog.max_level >= debug_stream::info) {
-		context.dclog << "type of then block: " << std::flush;
-		thenType->print(context.llclog);
-		(context.llclog << "\n").flush();
-		context.dclog << "type of else block: " << std::flush;
-		elseType->print(context.llclog);
-		(context.llclog << "\n").flush();
+	/* Scalar arms cheap enough to evaluate both of become a select, which the JIT doesn't if-convert itself at -O0 */
+	unsigned cost = 0;
+	if (type && (type->isIntegerTy() || type->isDoubleTy()) && speculatable(*thenblock, cost) && speculatable(*elseblock, cost)
+		&& cost <= context.selectThreshold) {
+		context.dclog << debug_stream::info << "Selecting between the arms of if " << this << std::endl;
+		auto thenValue = thenblock->codeGen(context);
+		auto elseValue = elseblock->codeGen(context);
+		auto value = context.builder.CreateSelect(CondInst, thenValue, elseValue, "ifv");
+		context.builder.CreateBr(merge_bb);
+		context.popBlockUntil(bblock);
+		context.popBlock();
+		context.dclog << debug_stream::indent(1, -1);
+		context.pushBlock(merge_bb, "merge", true);
+		context.dclog << debug_stream::info << "-Created if " << this << std::endl;
+		return value;
 	}
-	if (thenType != elseType) {
-		std::cerr << "elseblock and thenblock must have the same type!" << std::endl;
-		exit(0);
+
+	auto then_bb = BasicBlock::Create(context.llvmContext, context.trace() + "then", iff, merge_bb);
+	auto else_bb = BasicBlock::Create(context.llvmContext, context.trace() + "else", iff, merge_bb);
+	/* Both branches have this type, an if whose branches end in statements has no value */
+	Value* alloc = nullptr;
+	if (type && !type->isVoidTy()) {
+		alloc = context.entryAlloca(type, "ifv");
 	}
-	auto alloc = new AllocaInst(elseType, context.module->getDataLayout().getAllocaAddrSpace(), "ifv", context.currentBlock());
-	auto CondInst = new ICmpInst(*context.currentBlock(), ICmpInst::ICMP_NE, vcond, ConstantInt::get(Type::getInt1Ty(context.llvmContext), 0), "cond");
-	BranchInst::Create(then_bb, else_bb, CondInst, context.currentBlock());
+	context.builder.CreateCondBr(CondInst, then_bb, else_bb);
 
 	context.dclog << debug_stream::info << "Creating then block in " << this << std::endl;
 	context.dclog << debug_stream::indent(2, +1);
 	context.pushBlock(then_bb, "then", true);
-	auto thenValue = thenblock.codeGen(context);
-	auto thenStore = new StoreInst(thenValue, alloc, false, context.currentBlock());
-	context.setCurrentReturnValue(thenStore);
-	BranchInst::Create(merge_bb, context.currentBlock());
+	auto thenValue = thenblock->codeGen(context);
+	if (alloc) {
+		context.setCurrentReturnValue(context.builder.CreateStore(thenValue, alloc));
+	}
+	context.builder.CreateBr(merge_bb);
 	context.popBlockUntil(then_bb);
 	context.popBlock();
 	context.dclog << debug_stream::indent(2, -1);
@@ -456,10 +999,11 @@ Value* NIfBlock::codeGen(CodeGenContext& context)
 	context.dclog << debug_stream::info << "Creating else block " << this << std::endl;
 	context.dclog << debug_stream::indent(2, +1);
 	context.pushBlock(else_bb, "else", true);
-	auto elseValue = elseblock.codeGen(context);
-	auto elseStore = new StoreInst(elseValue, alloc, false, context.currentBlock());
-	context.setCurrentReturnValue(elseStore);
-	BranchInst::Create(merge_bb, context.currentBlock());
+	auto elseValue = elseblock->codeGen(context);
+	if (alloc) {
+		context.setCurrentReturnValue(context.builder.CreateStore(elseValue, alloc));
+	}
+	context.builder.CreateBr(merge_bb);
 	context.popBlockUntil(else_bb);
 	context.popBlock();
 	context.dclog << debug_stream::indent(2, -1);
@@ -471,7 +1015,54 @@ Value* NIfBlock::codeGen(CodeGenContext& context)
 	context.dclog << debug_stream::indent(1, -1);
 	context.pushBlock(merge_bb, "merge", true);
 	context.dclog << debug_stream::info << "-Created if " << this << std::endl;
-	return new LoadInst(alloc, "", false, context.currentBlock());
+	return alloc ? context.builder.CreateLoad(type, alloc) : nullptr;
+}
+
+/* A switch on the subject, which the backend turns into a jump table or a search instead of testing the
+   labels one after the other. Every arm stores its value the way the branches of an if do. */
+Value* NMatch::codeGen(CodeGenContext& context)
+{
+	context.dclog << debug_stream::info << "Creating match " << this << std::endl;
+	context.dclog << debug_stream::indent(1, +1);
+
+	auto iff = context.currentBlock()->getParent();
+	auto bblock = BasicBlock::Create(context.llvmContext, context.trace() + "match", iff);
+	auto merge_bb = BasicBlock::Create(context.llvmContext, context.trace() + "merge", iff);
+	context.builder.CreateBr(bblock);
+
+	context.pushBlock(bblock, "match", true);
+	auto vsubject = subject->codeGen(context);
+	Value* alloc = nullptr;
+	if (type && !type->isVoidTy()) {
+		alloc = context.entryAlloca(type, "matchv");
+	}
+	auto default_bb = BasicBlock::Create(context.llvmContext, context.trace() + "otherwise", iff, merge_bb);
+	auto dispatch = context.builder.CreateSwitch(vsubject, default_bb, static_cast<unsigned>(cases.size()));
+
+	auto generateArm = [&](BasicBlock* arm_bb, NExpression* arm) {
+		context.pushBlock(arm_bb, "arm", true);
+		auto value = arm->codeGen(context);
+		if (alloc) {
+			context.setCurrentReturnValue(context.builder.CreateStore(value, alloc));
+		}
+		context.builder.CreateBr(merge_bb);
+		context.popBlockUntil(arm_bb);
+		context.popBlock();
+	};
+	for (auto const& arm : cases) {
+		context.dclog << debug_stream::info << "Creating arm " << arm.first << " in " << this << std::endl;
+		auto arm_bb = BasicBlock::Create(context.llvmContext, context.trace() + "case", iff, default_bb);
+		dispatch->addCase(ConstantInt::get(Type::getInt64Ty(context.llvmContext), arm.first, true), arm_bb);
+		generateArm(arm_bb, arm.second);
+	}
+	generateArm(default_bb, otherwise);
+
+	context.popBlockUntil(bblock);
+	context.popBlock();
+	context.dclog << debug_stream::indent(1, -1);
+	context.pushBlock(merge_bb, "merge", true);
+	context.dclog << debug_stream::info << "-Created match " << this << std::endl;
+	return alloc ? context.builder.CreateLoad(type, alloc) : nullptr;
 }
 
 Value* NWhileBlock::codeGen(CodeGenContext& context)
@@ -480,21 +1071,23 @@ Value* NWhileBlock::codeGen(CodeGenContext& context)
 	auto bblock = BasicBlock::Create(context.llvmContext, context.trace() + "while", iff);
 	auto then_bb = BasicBlock::Create(context.llvmContext, context.trace() + "do", iff);
 	auto merge_bb = BasicBlock::Create(context.llvmContext, context.trace() + "join", iff);
-	BranchInst::Create(bblock, context.currentBlock());
+	context.builder.CreateBr(bblock);
 
 	context.pushBlock(bblock, "while", true);
-	auto condv = cond.codeGen(context);
-	auto vcond = castBoolean(condv, context);
-
-
-	Value* CondInst = new ICmpInst(*context.currentBlock(), ICmpInst::ICMP_NE, vcond, ConstantInt::get(Type::getInt1Ty(context.llvmContext), 0), "cond");
-	BranchInst::Create(then_bb, merge_bb, CondInst, context.currentBlock());
+	auto saved = saveStackIn(*this, context) ? stackSave(context) : nullptr;
+	auto condv = cond->codeGen(context);
+	auto CondInst = context.builder.CreateICmpNE(condv, ConstantInt::get(Type::getInt1Ty(context.llvmContext), 0), "cond");
+	context.builder.CreateCondBr(CondInst, then_bb, merge_bb);
 
 	context.dclog << debug_stream::info << "Creating while" << std::endl;
 	context.dclog << debug_stream::indent(2, +1);
 	context.pushBlock(then_bb, "do", true);
 	doblock.codeGen(context);
-	BranchInst::Create(bblock, context.currentBlock());
+	if (saved) stackRestore(saved, context);
+	auto backedge = context.builder.CreateBr(bblock);
+	if (context.osrEntries) {
+		backedge->setMetadata("toy.osr", MDNode::get(context.llvmContext, None));
+	}
 	context.popBlockUntil(then_bb);
 	context.popBlock();
 	context.popBlockUntil(bblock);
@@ -502,14 +1095,364 @@ Value* NWhileBlock::codeGen(CodeGenContext& context)
 	context.dclog << debug_stream::indent(2, -1);
 
 	context.pushBlock(merge_bb, "join", true);
+	if (saved) stackRestore(saved, context);
 	return condv;
 }
 
+/* Lowers to a counted loop over iv = 0..trip with i = from + iv * step, so the trip count is known on entry.
+   Pragmas written before the loop (@vectorize, @vectorize(width), @unroll, @unroll(count), @interleave(count))
+   become llvm.loop hints on its latch. */
+Value* NForBlock::codeGen(CodeGenContext& context)
+{
+	context.dclog << debug_stream::info << "Creating for " << this << std::endl;
+	context.dclog << debug_stream::indent(2, +1);
+	auto int64 = Type::getInt64Ty(context.llvmContext);
+	auto zero = ConstantInt::get(int64, 0);
+	auto one = ConstantInt::get(int64, 1);
+	auto from_v = from->codeGen(context);
+	auto to_v = to->codeGen(context);
+	auto step_v = step ? step->codeGen(context) : one;
+
+	/* The span and the step's magnitude are unsigned, so neither wraps however wide the range. A step of 0
+	   runs no iterations, and the divisor is 1 whenever there are none so the division can't trap. */
+	auto up = context.builder.CreateICmpSGT(step_v, zero);
+	auto down = context.builder.CreateICmpSLT(step_v, zero);
+	auto span = context.builder.CreateSelect(up, context.builder.CreateSub(to_v, from_v), context.builder.CreateSub(from_v, to_v), "span");
+	auto magnitude = context.builder.CreateSelect(up, step_v, context.builder.CreateNeg(step_v));
+	auto runs = context.builder.CreateSelect(up, context.builder.CreateICmpSLT(from_v, to_v),
+		context.builder.CreateAnd(down, context.builder.CreateICmpSGT(from_v, to_v)), "runs");
+	auto divisor = context.builder.CreateSelect(runs, magnitude, one);
+	auto trip = context.builder.CreateAdd(context.builder.CreateUDiv(context.builder.CreateSub(span, one), divisor), one);
+	trip = context.builder.CreateSelect(runs, trip, zero, "trip");
+
+	std::map<std::string, int64_t> hints;
+	for (auto const& pragma : pragmas) {
+		if (pragma.first == "vectorize") {
+			hints["vectorize.enable"] = 1;
+			if (pragma.second) hints["vectorize.width"] = pragma.second;
+		} else if (pragma.first == "unroll") {
+			if (pragma.second) hints["unroll.count"] = pragma.second;
+			else hints["unroll.enable"] = 1;
+		} else if (pragma.first == "interleave") {
+			hints["interleave.count"] = pragma.second;
+		} else {
+			context.dclog << debug_stream::warn << "Ignoring unknown loop pragma " << pragma.first << std::endl;
+		}
+	}
+
+	auto iv = context.entryAlloca(int64, id.name);
+	auto saveStack = saveStackIn(doblock, context);
+	emitCountedLoop(context, trip, hints.empty() ? nullptr : loopMetadata(context, hints), [&](Value* i) {
+		auto saved = saveStack ? stackSave(context) : nullptr;
+		context.locals()[id.name] = iv;
+		context.builder.CreateStore(context.builder.CreateAdd(from_v, context.builder.CreateMul(i, step_v)), iv);
+		doblock.codeGen(context);
+		if (saved) stackRestore(saved, context);
+	});
+	context.dclog << debug_stream::indent(2, -1);
+	context.dclog << debug_stream::info << "-Created for " << this << std::endl;
+	return trip;
+}
+
+static FunctionType* signatureOf(NFunctionDeclaration& fn, CodeGenContext& context)
+{
+	std::vector<Type*> argTypes;
+	for (auto arg : fn.arguments) {
+		argTypes.push_back(typeOf(arg->type, context));
+	}
+	return FunctionType::get(typeOf(fn.type, context), makeArrayRef(argTypes), false);
+}
+
+/* Names the module of a top-level function by a hash of its AST, the signatures of what it calls, the
+   options it is compiled with, the builtins linked into it and the build of the compiler. Top-level
+   functions can't see the variables of the script, so that is all the environment they have. */
+std::string CodeGenContext::unitKey(NFunctionDeclaration& fn, const std::map<std::string, FunctionType*>& externs)
+{
+	std::string text;
+	raw_string_ostream out(text);
+	out << "unit " << buildId << " " << builtinsHash << " " << optimize << " " << inlineThreshold << " " << selectThreshold << " " << sys::getHostCPUName() << "\n";
+	auto index = ast.indexOf(&fn);
+	std::set<std::string> vars, calls, defined;
+	collectNames(ast, index, vars, calls, defined);
+	for (auto const& name : calls) {
+		if (defined.count(name)) continue;
+		out << "\n" << name << " ";
+		auto persistent = persistentFunctions.find(name);
+		auto external = externs.find(name);
+		if (persistent != persistentFunctions.end()) {
+			persistent->second.type->print(out);
+		} else if (external != externs.end()) {
+			external->second->print(out);
+		}
+	}
+	MD5 hash;
+	hashNode(ast, index, hash);
+	hash.update(out.str());
+	MD5::MD5Result digest;
+	hash.final(digest);
+	return "fn." + fn.id.name + "." + digest.digest().str().str();
+}
+
+/* Splits the top-level functions off into modules of their own, externs are declared in all of them.
+   The functions the object cache already has are only declared, their AST is not looked at again. With
+   lazyFunctions every function is only declared and set aside for generateDeferred. */
+void CodeGenContext::generateUnits(NBlock& root, std::set<NStatement*>& generated)
+{
+	auto mainModule = module;
+	auto mainGlobalFun = globalFun;
+	std::vector<NExternDeclaration*> externs;
+	std::map<std::string, FunctionType*> externTypes;
+	/* The tags say what the statements are without touching the nodes that are neither */
+	for (auto index : ast.operandsOf(ast.indexOf(&root))) {
+		auto tag = ast.tags[index];
+		if (tag == NodeKind::ExternDeclaration) {
+			auto ext = static_cast<NExternDeclaration*>(ast.nodes[index]);
+			externTypes[ext->id.name] = static_cast<Function*>(ext->codeGen(*this))->getFunctionType();
+			externs.push_back(ext);
+			generated.insert(ext);
+			continue;
+		}
+		if (tag != NodeKind::FunctionDeclaration || ast.operandsOf(index)[0]) continue;
+		auto fn = static_cast<NFunctionDeclaration*>(ast.nodes[index]);
+		generated.insert(fn);
+		if (persistentFunctions.count(fn->id.name)) {
+			/* The first definition wins, as it does in a single module */
+			continue;
+		}
+		if (lazyFunctions) {
+			dclog << debug_stream::info << "Deferring " << fn->id.name << std::endl;
+			persistFunction(fn->id.name, signatureOf(*fn, *this));
+			deferredFunctions.push_back(DeferredFunction{fn, externs});
+			continue;
+		}
+		auto key = unitKey(*fn, externTypes);
+		if (objectCache && objectCache->contains(key)) {
+			dclog << debug_stream::info << "Reusing " << key << std::endl;
+			persistFunction(fn->id.name, signatureOf(*fn, *this));
+			units.push_back(new Module(key, llvmContext));
+			continue;
+		}
+		dclog << debug_stream::info << "Generating " << key << std::endl;
+		generateUnit(key, *fn, externs);
+		units.push_back(module);
+	}
+	module = mainModule;
+	globalFun = mainGlobalFun;
+	functionCache.clear();
+	importedFun.clear();
+}
+
+void CodeGenContext::generateUnit(const std::string& key, NFunctionDeclaration& fn, const std::vector<NExternDeclaration*>& externs)
+{
+	newModule(key);
+	createCoreFunctions(*this);
+	importPersistentSymbols();
+	for (auto ext : externs) {
+		ext->codeGen(*this);
+	}
+	fn.codeGen(*this);
+	linkBuiltins();
+}
+
+/* Generates a deferred function the way generateUnits would have, the JIT asks for it on its first call */
+Module* CodeGenContext::generateDeferred(const DeferredFunction& function)
+{
+	auto lock = threadSafeContext.getLock();
+	auto mainModule = module;
+	auto mainGlobalFun = globalFun;
+	auto& name = function.declaration->id.name;
+	dclog << debug_stream::info << "Generating deferred " << name << std::endl;
+	/* It was declared up front, the definition takes that symbol instead of looking like a redefinition */
+	persistentFunctions.erase(name);
+	generateUnit("fn." + name, *function.declaration, function.externs);
+	auto unit = module;
+	module = mainModule;
+	globalFun = mainGlobalFun;
+	functionCache.clear();
+	importedFun.clear();
+	return unit;
+}
+
+static Value* reduce(const std::string& op, Value* lhs, Value* rhs, CodeGenContext& context)
+{
+	auto fp = lhs->getType()->isDoubleTy();
+	if (op == "+") return fp ? context.builder.CreateFAdd(lhs, rhs) : context.builder.CreateAdd(lhs, rhs);
+	if (op == "*") return fp ? context.builder.CreateFMul(lhs, rhs) : context.builder.CreateMul(lhs, rhs);
+	auto less = fp ? context.builder.CreateFCmpOLT(rhs, lhs) : context.builder.CreateICmpSLT(rhs, lhs);
+	return op == "min" ? context.builder.CreateSelect(less, rhs, lhs) : context.builder.CreateSelect(less, lhs, rhs);
+}
+
+/* The body is outlined into "T body(i64 lo, i64 hi, i8* env)", where env holds pointers to the captured
+   variables, and the runtime runs it over chunks of [from, to) on its worker pool.
+   Writes to captured variables are not synchronized, only the reduction variable is privatized per chunk. */
+Value* NParallelFor::codeGen(CodeGenContext& context)
+{
+	context.dclog << debug_stream::info << "Creating parallel for " << this << std::endl;
+	context.dclog << debug_stream::indent(2, +1);
+	auto int64 = Type::getInt64Ty(context.llvmContext);
+	auto from_v = from->codeGen(context);
+	auto to_v = to->codeGen(context);
+
+	Value* reduction_loc = nullptr;
+	auto resultType = static_cast<Type*>(int64);
+	auto op = REDUCE_NONE;
+	Value* identity = ConstantInt::get(int64, 0);
+	if (reduction) {
+		if (!((reduction_loc = context.find_locals(reduction->name)))) {
+			std::cerr << "undeclared variable " << reduction->name << std::endl;
+			context.fail();
+		}
+		resultType = reduction_loc->getType()->getPointerElementType();
+		auto fp = resultType->isDoubleTy();
+		if (!fp && resultType != int64) {
+			std::cerr << "reduction variable " << reduction->name << " must be int or double" << std::endl;
+			context.fail();
+		}
+		if (reduceOp == "+") {
+			op = REDUCE_ADD;
+			identity = fp ? ConstantFP::get(resultType, 0.0) : ConstantInt::get(int64, 0);
+		} else if (reduceOp == "*") {
+			op = REDUCE_MUL;
+			identity = fp ? ConstantFP::get(resultType, 1.0) : ConstantInt::get(int64, 1);
+		} else if (reduceOp == "min") {
+			op = REDUCE_MIN;
+			identity = fp ? ConstantFP::getInfinity(resultType) : ConstantInt::get(int64, std::numeric_limits<int64_t>::max());
+		} else if (reduceOp == "max") {
+			op = REDUCE_MAX;
+			identity = fp ? ConstantFP::getInfinity(resultType, true) : ConstantInt::get(int64, std::numeric_limits<int64_t>::min());
+		} else {
+			std::cerr << "unknown reduction " << reduceOp << std::endl;
+			context.fail();
+		}
+	}
+
+	/* Find what the body captures, including what the local functions it calls capture */
+	std::set<std::string> vars, calls, defined;
+	collectNames(context.ast, context.ast.indexOf(&doblock), vars, calls, defined);
+	std::map<std::string, Value*> localFunctions;
+	for (auto const& name : calls) {
+		if (defined.count(name) || context.findFunction(name)) continue;
+		auto fn = context.ftrace() + "__fn_" + name;
+		auto loc = context.find_locals(fn);
+		if (loc) localFunctions[fn] = loc;
+		for (auto const& ex : context.extra[fn]) vars.insert(ex);
+	}
+	std::vector<std::string> captureNames;
+	std::vector<Value*> captures;
+	std::vector<Type*> envTypes;
+	for (auto const& name : vars) {
+		if (defined.count(name) || (reduction && name == reduction->name)) continue;
+		auto loc = context.find_locals(name);
+		if (!loc) continue;
+		context.dclog << "capturing " << name << std::endl;
+		captureNames.push_back(name);
+		captures.push_back(loc);
+		envTypes.push_back(loc->getType());
+	}
+	auto envType = StructType::get(context.llvmContext, makeArrayRef(envTypes));
+	auto env = context.entryAlloca(envType, "env");
+	for (unsigned i = 0; i < captures.size(); ++i) {
+		context.builder.CreateStore(captures[i], context.builder.CreateStructGEP(envType, env, i));
+	}
+
+	/* Outline the body */
+	auto voidPtr = Type::getInt8PtrTy(context.llvmContext);
+	std::vector<Type*> argTypes;
+	argTypes.push_back(int64);
+	argTypes.push_back(int64);
+	argTypes.push_back(voidPtr);
+	auto ftype = FunctionType::get(resultType, makeArrayRef(argTypes), false);
+	auto function = Function::Create(ftype, GlobalValue::PrivateLinkage, context.ftrace() + "__parallel", context.module);
+	auto bblock = BasicBlock::Create(context.llvmContext, "entry", function, nullptr);
+	context.pushBlock(bblock, "parallel");
+	auto args = function->arg_begin();
+	Value* lo = &*args++;
+	Value* hi = &*args++;
+	Value* envArg = &*args;
+	lo->setName("lo");
+	hi->setName("hi");
+	envArg->setName("env");
+	auto envPtr = context.builder.CreateBitCast(envArg, envType->getPointerTo());
+	for (unsigned i = 0; i < captures.size(); ++i) {
+		context.locals()[captureNames[i]] = context.builder.CreateLoad(envTypes[i], context.builder.CreateStructGEP(envType, envPtr, i), captureNames[i]);
+	}
+	for (auto const& fn : localFunctions) {
+		context.locals()[fn.first] = fn.second;
+	}
+	Value* acc = nullptr;
+	if (reduction) {
+		acc = context.builder.CreateAlloca(resultType, nullptr, reduction->name);
+		context.builder.CreateStore(identity, acc);
+		context.locals()[reduction->name] = acc;
+	}
+	auto iv = context.builder.CreateAlloca(int64, nullptr, id.name);
+	context.locals()[id.name] = iv;
+	auto saveStack = saveStackIn(doblock, context);
+	emitCountedLoop(context, context.builder.CreateSub(hi, lo), nullptr, [&](Value* i) {
+		auto saved = saveStack ? stackSave(context) : nullptr;
+		context.builder.CreateStore(context.builder.CreateAdd(lo, i), iv);
+		doblock.codeGen(context);
+		if (saved) stackRestore(saved, context);
+	});
+	if (acc) {
+		context.builder.CreateRet(context.builder.CreateLoad(resultType, acc));
+	} else {
+		context.builder.CreateRet(ConstantInt::get(int64, 0));
+	}
+	context.popBlockUntil(bblock);
+	context.popBlock();
+
+	/* Hand it to the runtime and fold the result into the reduction variable */
+	auto runtimeName = resultType->isDoubleTy() ? "toy_parallel_for_f64" : "toy_parallel_for_i64";
+	auto runtime = context.module->getFunction(runtimeName);
+	if (!runtime) {
+		std::vector<Type*> runtimeArgs;
+		runtimeArgs.push_back(int64);
+		runtimeArgs.push_back(int64);
+		runtimeArgs.push_back(ftype->getPointerTo());
+		runtimeArgs.push_back(voidPtr);
+		runtimeArgs.push_back(Type::getInt32Ty(context.llvmContext));
+		runtimeArgs.push_back(resultType);
+		runtime = Function::Create(FunctionType::get(resultType, makeArrayRef(runtimeArgs), false), GlobalValue::ExternalLinkage, runtimeName, context.module);
+	}
+	std::vector<Value*> callArgs;
+	callArgs.push_back(from_v);
+	callArgs.push_back(to_v);
+	callArgs.push_back(function);
+	callArgs.push_back(context.builder.CreateBitCast(env, voidPtr));
+	callArgs.push_back(ConstantInt::get(Type::getInt32Ty(context.llvmContext), op));
+	callArgs.push_back(identity);
+	Value* result = context.builder.CreateCall(runtime, makeArrayRef(callArgs));
+	if (reduction) {
+		result = reduce(reduceOp, context.builder.CreateLoad(resultType, reduction_loc), result, context);
+		context.builder.CreateStore(result, reduction_loc);
+	}
+	context.dclog << debug_stream::indent(2, -1);
+	context.dclog << debug_stream::info << "-Created parallel for " << this << std::endl;
+	return result;
+}
+
 Value* NVariableDefinition::codeGen(CodeGenContext& context)
 {
 	context.dclog << debug_stream::info << "Creating variable declaration " << type.name << " " << id.name << std::endl;
-	auto alloc = new AllocaInst(typeOf(type, context), context.module->getDataLayout().getAllocaAddrSpace(), id.name.c_str(), context.currentBlock());
+	auto allocType = typeOf(type, context);
+	if (immutable && !context.isGlobal(this)) {
+		/* Never assigned, so the name stands for the value itself and needs no memory */
+		auto value = assignmentExpr->codeGen(context);
+		if (isa<Instruction>(value) && !value->hasName()) value->setName(id.name);
+		context.locals()[id.name] = value;
+		return value;
+	}
+	Value* alloc = context.isGlobal(this) ?
+		               static_cast<Value*>(context.persistGlobal(id.name, allocType))
+		               : context.entryAlloca(allocType, id.name);
 	context.locals()[id.name] = alloc;
+	if (context.arrayElementType(allocType)) {
+		/* int[] variables alias the array they are initialized with */
+		auto header = assignmentExpr ? assignmentExpr->codeGen(context) : Constant::getNullValue(allocType);
+		context.builder.CreateStore(header, alloc);
+		return alloc;
+	}
 	if (assignmentExpr != nullptr) {
 		context.dclog << debug_stream::info << "Creating initializer " << type.name << " " << id.name << std::endl;
 		NAssignment assn(id, *assignmentExpr);
@@ -520,6 +1463,47 @@ Value* NVariableDefinition::codeGen(CodeGenContext& context)
 	return alloc;
 }
 
+Value* NArrayDefinition::codeGen(CodeGenContext& context)
+{
+	context.dclog << debug_stream::info << "Creating array definition " << type.name << "[] " << id.name << std::endl;
+	auto elementType = typeOf(type, context);
+	auto headerType = context.arrayType(elementType);
+	auto length = size->codeGen(context);
+	Value* data;
+	Value* header;
+	if (context.isGlobal(this)) {
+		/* Top-level arrays outlive the entry function that defines them */
+		auto malloc = context.module->getOrInsertFunction("malloc", Type::getInt8PtrTy(context.llvmContext), Type::getInt64Ty(context.llvmContext));
+		auto elementSize = context.module->getDataLayout().getTypeAllocSize(elementType);
+		auto bytes = context.builder.CreateMul(length, ConstantInt::get(Type::getInt64Ty(context.llvmContext), elementSize));
+		data = context.builder.CreateBitCast(context.builder.CreateCall(malloc, bytes), elementType->getPointerTo());
+		header = context.persistGlobal(id.name, headerType);
+	} else if (isa<NInteger>(size)) {
+		/* A known length is allocated with the frame, like a scalar, however often the definition runs */
+		data = context.entryAlloca(elementType, id.name + ".data", length);
+		header = context.entryAlloca(headerType, id.name);
+	} else {
+		/* Loops around it give the space back every iteration, see saveStackIn */
+		data = context.builder.CreateAlloca(elementType, length, id.name + ".data");
+		header = context.entryAlloca(headerType, id.name);
+	}
+	context.builder.CreateStore(length, context.builder.CreateStructGEP(headerType, header, 0));
+	context.builder.CreateStore(data, context.builder.CreateStructGEP(headerType, header, 1));
+	context.locals()[id.name] = header;
+	if (assignmentExpr != nullptr) {
+		context.dclog << debug_stream::info << "Creating initializer " << type.name << "[] " << id.name << std::endl;
+		context.dclog << debug_stream::indent(2, +1);
+		assignElementwise(header, *assignmentExpr, context);
+		context.dclog << debug_stream::indent(2, -1);
+	} else {
+		/* Starts out zeroed, as the interpreter has it */
+		auto elementSize = context.module->getDataLayout().getTypeAllocSize(elementType);
+		auto bytes = context.builder.CreateMul(length, ConstantInt::get(Type::getInt64Ty(context.llvmContext), elementSize));
+		context.builder.CreateMemSet(data, context.builder.getInt8(0), bytes, MaybeAlign());
+	}
+	return header;
+}
+
 Value* NExternDeclaration::codeGen(CodeGenContext& context)
 {
 	context.dclog << debug_stream::info << "Creatinge extern declaration " << type.name << " " << id.name << "( ";
@@ -531,12 +1515,13 @@ Value* NExternDeclaration::codeGen(CodeGenContext& context)
 	context.dclog << ")" << std::endl;
 	auto ftype = FunctionType::get(typeOf(type, context), makeArrayRef(argTypes), false);
 	auto function = Function::Create(ftype, GlobalValue::ExternalLinkage, id.name.c_str(), context.module);
+	context.externs.insert(id.name);
 	return function;
 }
 
 Value* NFunctionDeclaration::codeGen(CodeGenContext& context)
 {
-	static std::map<std::string, std::map<std::string, Function*>> def;
+	auto& def = context.functionCache;
 	context.dclog << debug_stream::info << "Creating function: " << id.name << std::endl;
 	if(def[context.ftrace()].find(id.name) != def[context.ftrace()].end()) {
 		context.dclog << "Found function: " << id.name << " at " << context.ftrace() << std::endl;
@@ -552,11 +1537,16 @@ Value* NFunctionDeclaration::codeGen(CodeGenContext& context)
 		argTypes.push_back(typeOf((*it)->type, context));
 	}
 	auto ftype = FunctionType::get(typeOf(type, context), makeArrayRef(argTypes), false);
-	auto function = local ?
-		                Function::Create(ftype, GlobalValue::PrivateLinkage, context.ftrace() + "__fn_" + id.name, context.module)
-		                : Function::Create(ftype, GlobalValue::InternalLinkage, id.name, context.module);
+	Function* function;
 	if (local) {
+		function = Function::Create(ftype, GlobalValue::PrivateLinkage, context.ftrace() + "__fn_" + id.name, context.module);
 		context.locals()[context.ftrace() + "__fn_" + id.name] = function;
+	} else if (context.incremental || context.separateFunctions) {
+		/* Later modules call it through a declaration, so it has to be visible outside this one */
+		function = Function::Create(ftype, GlobalValue::ExternalLinkage, context.persistFunction(id.name, ftype), context.module);
+		context.importedFun[id.name] = function;
+	} else {
+		function = Function::Create(ftype, GlobalValue::InternalLinkage, id.name, context.module);
 	}
 	context.dclog << "Creating basicblock " << function << std::endl;
 	auto bblock = BasicBlock::Create(context.llvmContext, "entry", function, nullptr);
@@ -570,7 +1560,7 @@ Value* NFunctionDeclaration::codeGen(CodeGenContext& context)
 		(*it)->codeGen(context);
 		Value* argumentValue = &(*argsValues++);
 		argumentValue->setName((*it)->id.name);
-		auto inst = new StoreInst(argumentValue, context.locals()[(*it)->id.name], false, bblock);
+		auto inst = context.builder.CreateStore(argumentValue, context.locals()[(*it)->id.name]);
 		storeInst.push_back(inst);
 		context.dclog << debug_stream::indent(2, -1);
 	}
@@ -593,9 +1583,19 @@ Value* NFunctionDeclaration::codeGen(CodeGenContext& context)
 		context.funcBlocks.pop_back();
 		context.dclog << debug_stream::info;
 		context.dclog << debug_stream::indent(2, -1);
+		/* The captures are the fields of one environment the caller passes a pointer to, the ones the
+		   function never writes by value, so neither side has to keep them in memory */
+		std::set<std::string> written;
+		collectWrites(context.ast, context.ast.indexOf(this), written);
+		std::vector<Type*> envTypes;
 		for (auto ex: context.extra[context.ftrace() + "__fn_" + id.name]) {
-			argTypes.push_back(context.find_locals(ex)->getType());
+			auto loc = context.find_locals(ex);
+			auto byValue = !written.count(ex) && !isa<Function>(loc);
+			auto bound = !loc->getType()->isPointerTy();
+			envTypes.push_back(byValue && !bound ? loc->getType()->getPointerElementType() : loc->getType());
 		}
+		auto envType = StructType::create(context.llvmContext, makeArrayRef(envTypes), context.ftrace() + "__env_" + id.name);
+		argTypes.push_back(envType->getPointerTo());
 		ftype = FunctionType::get(typeOf(type, context), makeArrayRef(argTypes), false);
 		function = Function::Create(ftype, GlobalValue::PrivateLinkage, context.ftrace() + "__fn_" + id.name, context.module);
 		context.locals()[context.ftrace() + "__fn_" + id.name] = function;
@@ -610,19 +1610,22 @@ Value* NFunctionDeclaration::codeGen(CodeGenContext& context)
 			(*it)->codeGen(context);
 			Value* argumentValue = &(*argsValues++);
 			argumentValue->setName((*it)->id.name);
-			auto inst = new StoreInst(argumentValue, context.locals()[(*it)->id.name], false, bblock);
+			auto inst = context.builder.CreateStore(argumentValue, context.locals()[(*it)->id.name]);
 			storeInst.push_back(inst);
 			context.dclog << debug_stream::indent(2, -1);
 		}
-		for (auto ex: context.extra[context.ftrace(1) + "__fn_" + id.name]) {
-			context.dclog << debug_stream::info << "Setting extra argument " << ex << std::endl;
-			if (argsValues == function->arg_end()) {
-				std::cerr << "Argument count mismatch!" << std::endl;
-				exit(1);
-			}
-			Value* argumentPointer = &(*argsValues++);
-			argumentPointer->setName(context.ftrace() + ex);
-			context.locals()[ex] = argumentPointer;
+		auto& captures = context.extra[context.ftrace(1) + "__fn_" + id.name];
+		if (captures.size() != envTypes.size()) {
+			std::cerr << "Argument count mismatch!" << std::endl;
+			context.fail();
+		}
+		Value* env = &(*argsValues);
+		env->setName("env");
+		for (unsigned field = 0; field < envTypes.size(); ++field) {
+			auto ex = captures[field];
+			context.dclog << debug_stream::info << "Setting capture " << ex << std::endl;
+			/* A value nothing in the function writes is used as it is, like a let */
+			context.locals()[ex] = context.builder.CreateLoad(envTypes[field], context.builder.CreateStructGEP(envType, env, field), context.ftrace() + ex);
 		}
 		context.dclog << "Generating function body for " << id.name << std::endl;
 		context.dclog << debug_stream::indent(2, +1);
@@ -636,7 +1639,7 @@ Value* NFunctionDeclaration::codeGen(CodeGenContext& context)
 		context.dclog << debug_stream::info;
 	}
 	
-	ReturnInst::Create(context.llvmContext, context.getCurrentReturnValue(), context.currentBlock());
+	context.builder.CreateRet(context.getCurrentReturnValue());
 	context.popBlockUntil(bblock);
 	context.popBlock();
 	context.funcBlocks.pop_back();
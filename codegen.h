@@ -1,7 +1,9 @@
 #pragma once
 #include <iostream>
+#include <set>
 #include <vector>
 #include "debug_stream.hpp"
+#include "flatast.h"
 #include <string>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Function.h>
@@ -12,12 +14,19 @@
 #include <llvm/IR/Intrinsics.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/Target/TargetMachine.h>
 #include <llvm/ExecutionEngine/GenericValue.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
 #include <llvm/Support/raw_os_ostream.h>
 
 using namespace llvm;
 
 class NBlock;
+class NIdentifier;
+class NStatement;
+class NFunctionDeclaration;
+class NExternDeclaration;
 
 class CodeGenBlock
 {
@@ -30,6 +39,42 @@ public:
 	std::map<std::string, Value*> locals;
 };
 
+/* Thrown by CodeGenContext::fail when compiling incrementally, where an error drops the input rather than the session */
+struct CompileError {};
+
+/* A top-level function or variable that outlives the module it was compiled into */
+struct PersistentSymbol
+{
+	std::string symbol;
+	Type* type;
+};
+
+/* A top-level function that stays AST until it is first called, with the externs declared before it */
+struct DeferredFunction
+{
+	NFunctionDeclaration* declaration;
+	std::vector<NExternDeclaration*> externs;
+};
+
+/* Objects compiled earlier, one file per module identifier, so identifiers have to name the content */
+class ObjectFileCache : public ObjectCache
+{
+	std::string directory;
+
+	std::string pathOf(const std::string& identifier) const;
+
+public:
+	explicit ObjectFileCache(std::string directory): directory(std::move(directory)) {}
+
+	/* Drops the files of a cache directory nobody used for a while, and the least recently used ones while
+	   it is too big. Checks at most every 20 minutes. */
+	static void prune(const std::string& directory);
+
+	bool contains(const std::string& identifier) const;
+	void notifyObjectCompiled(const Module* module, MemoryBufferRef object) override;
+	std::unique_ptr<MemoryBuffer> getObject(const Module* module) override;
+};
+
 class CodeGenContext
 {
 	std::vector<CodeGenBlock *> blocks;
@@ -38,14 +83,63 @@ public:
 	raw_os_ostream llclog{std::clog};
 	debug_stream dclog;
 	Module* module;
-	LLVMContext llvmContext;
+	orc::ThreadSafeContext threadSafeContext;
+	LLVMContext& llvmContext;
+	IRBuilder<ConstantFolder> builder;
 	std::map<std::string, Function*> globalFun;
+	std::map<std::string, std::map<std::string, Function*>> functionCache;
 	std::vector<std::string> funcBlocks;
 	std::map<std::string, std::vector<std::string>> extra;
+	std::map<Type*, StructType*> arrayTypes;
+	bool optimize = false;
+	bool dumpModule = true;
+	/* Calls to local functions with bodies of up to this many nodes are inlined before code generation, 0 turns it off */
+	unsigned inlineThreshold = 24;
+	/* Ifs whose arms are side-effect-free and have up to this many nodes together become a select, 0 turns it off */
+	unsigned selectThreshold = 8;
+	/* Entries plus loop iterations after which runTiered compiles a function again with optimization */
+	unsigned tierThreshold = 1000;
+	/* Tags the back-edges of while loops, runTiered lets a running loop move over to an optimized copy there */
+	bool osrEntries = false;
+	ObjectFileCache* objectCache = nullptr;
+	std::unique_ptr<Module> builtins;
+	/* Hashes of the builtins bitcode and of the compiler executable, which cached objects depend on too */
+	std::string builtinsHash;
+	std::string buildId;
+	FlatAst ast;
+
+	/* Every top-level function gets a module of its own, keyed by what its code depends on, so the
+	   object cache hands back the ones that did not change instead of generating them again */
+	bool separateFunctions = false;
+	std::vector<Module*> units;
+	/* With separateFunctions, top-level functions are only declared and runLazy generates each on its first call */
+	bool lazyFunctions = false;
+	std::vector<DeferredFunction> deferredFunctions;
 
-	CodeGenContext(): mainFunction(nullptr), dclog("Debug", debug_stream::verbose, std::clog), llvmContext()
+	/* Incremental compilation: every top-level input gets a module of its own, and top-level
+	   functions and variables are redeclared in the modules that come after it */
+	bool incremental = false;
+	const NStatement* topLevelStatement = nullptr;
+	std::map<std::string, PersistentSymbol> persistentFunctions;
+	std::map<std::string, PersistentSymbol> persistentGlobals;
+	std::map<std::string, Function*> importedFun;
+	int redefinitions = 0;
+	/* With incremental, echoes the value of every top-level expression by its type, as the REPL shows them */
+	bool echoResults = false;
+	/* The functions declared with extern, which may write to stdout behind the echo buffer's back */
+	std::set<std::string> externs;
+
+	CodeGenContext(): mainFunction(nullptr), dclog("Debug", debug_stream::verbose, std::clog),
+	                  threadSafeContext(std::make_unique<LLVMContext>()), llvmContext(*threadSafeContext.getContext()), builder(llvmContext)
+	{
+		newModule("main");
+	}
+
+	void newModule(const std::string& name)
 	{
-		module = new Module("main", llvmContext);
+		module = new Module(name, llvmContext);
+		functionCache.clear();
+		importedFun.clear();
 		std::vector<Type *> powfArgumentTypes;
 		powfArgumentTypes.push_back(Type::getDoubleTy(llvmContext));
 		powfArgumentTypes.push_back(Type::getDoubleTy(llvmContext));
@@ -56,11 +150,118 @@ public:
 	{
 		auto powf = getDeclaration(module, intid, makeArrayRef(Tys));
 		powf->setName(name);
-		globalFun.insert(std::pair<std::string, Function*>(id, powf));
+		globalFun[id] = powf;
 	}
 
-	void generateCode(NBlock& root);
+	/* Ends compilation after an error in the program was reported: exits, or throws CompileError for the REPL */
+	[[noreturn]] void fail()
+	{
+		if (incremental) throw CompileError();
+		exit(1);
+	}
+
+	/* Drops the module an input failed in, with the blocks its generation left open */
+	void discardModule()
+	{
+		while (!blocks.empty()) {
+			delete blocks.back();
+			blocks.pop_back();
+		}
+		funcBlocks.clear();
+		functionCache.clear();
+		importedFun.clear();
+		topLevelStatement = nullptr;
+		builder.ClearInsertionPoint();
+		delete module;
+		module = nullptr;
+		mainFunction = nullptr;
+	}
+
+	/* Inlines and types the tree, what every back end needs done before it looks at it */
+	void prepareTree(NBlock& root);
+	void generateCode(NBlock& root, const std::string& entry = "main");
+	void echoResult(NStatement& statement, Value* value);
+	void generateUnits(NBlock& root, std::set<NStatement*>& generated);
+	void generateUnit(const std::string& key, NFunctionDeclaration& fn, const std::vector<NExternDeclaration*>& externs);
+	Module* generateDeferred(const DeferredFunction& function);
+	std::string unitKey(NFunctionDeclaration& fn, const std::map<std::string, FunctionType*>& externs);
+	bool loadBuiltins(const std::string& path);
+	void linkBuiltins();
+	void optimizeModule(TargetMachine& tm, Module& m);
 	GenericValue runCode();
+	int64_t runTiered();
+	int64_t runLazy();
+
+	bool isGlobal(const NStatement* statement) const
+	{
+		return incremental && statement == topLevelStatement;
+	}
+
+	Function* findFunction(const std::string& name)
+	{
+		auto found = importedFun.find(name);
+		if (found != importedFun.end()) {
+			return found->second;
+		}
+		return module->getFunction(name);
+	}
+
+	/* Picks the symbol for a top-level function, a redefinition gets a fresh one so earlier code keeps its callee */
+	std::string persistFunction(const std::string& name, FunctionType* type)
+	{
+		auto symbol = persistentFunctions.count(name) ? name + "." + std::to_string(++redefinitions) : name;
+		persistentFunctions[name] = PersistentSymbol{symbol, type};
+		return symbol;
+	}
+
+	GlobalVariable* persistGlobal(const std::string& name, Type* type)
+	{
+		auto found = persistentGlobals.find(name);
+		if (found != persistentGlobals.end()) {
+			if (found->second.type != type) {
+				std::cerr << name << " is already defined with another type" << std::endl;
+				fail();
+			}
+			return module->getGlobalVariable(found->second.symbol);
+		}
+		auto symbol = "var." + name;
+		persistentGlobals[name] = PersistentSymbol{symbol, type};
+		return new GlobalVariable(*module, type, false, GlobalValue::ExternalLinkage, Constant::getNullValue(type), symbol);
+	}
+
+	void importPersistentSymbols()
+	{
+		for (auto const& fn : persistentFunctions) {
+			auto ftype = static_cast<FunctionType*>(fn.second.type);
+			importedFun[fn.first] = Function::Create(ftype, GlobalValue::ExternalLinkage, fn.second.symbol, module);
+		}
+		for (auto const& var : persistentGlobals) {
+			locals()[var.first] = new GlobalVariable(*module, var.second.type, false, GlobalValue::ExternalLinkage, nullptr, var.second.symbol);
+		}
+	}
+
+	/* Arrays are passed around as a { length, data } header */
+	StructType* arrayType(Type* element)
+	{
+		auto found = arrayTypes.find(element);
+		if (found != arrayTypes.end()) {
+			return found->second;
+		}
+		std::vector<Type*> fields;
+		fields.push_back(Type::getInt64Ty(llvmContext));
+		fields.push_back(element->getPointerTo());
+		auto type = StructType::create(llvmContext, makeArrayRef(fields), "array");
+		arrayTypes[element] = type;
+		return type;
+	}
+
+	Type* arrayElementType(Type* type) const
+	{
+		for (auto const& a : arrayTypes) {
+			if (a.second == type) return a.first;
+		}
+		return nullptr;
+	}
 
 	std::map<std::string, Value*>& locals() const
 	{
@@ -80,9 +281,11 @@ public:
 				if (througthFun) {
 					auto level = througthFun + 1;
 					while (--level) {
-						auto& ex = extra[ftrace(level) + "__" + funcBlocks.back()];
+						/* Every function between here and the variable captures it */
+						auto key = ftrace(level) + "__" + funcBlocks[funcBlocks.size() - level];
+						auto& ex = extra[key];
 						if (std::find(ex.begin(), ex.end(), s) == ex.end()) {
-							dclog << "marking " + s + " as extra in " << ftrace(level) + "__" + funcBlocks.back() << std::endl;
+							dclog << "marking " + s + " as extra in " << key << std::endl;
 							ex.push_back(s);
 						}
 					}
@@ -111,18 +314,27 @@ public:
 		return a;
 	}
 
+	/* The names of the enclosing functions but the innermost r */
 	std::string ftrace(int r = 0)
 	{
 		std::string a("");
-		auto n = funcBlocks.size() - r;
+		auto n = funcBlocks.size() - std::min<size_t>(r, funcBlocks.size());
 		for (auto const& s : funcBlocks) {
+			if (!n--) { break; }
 			a += s + "_";
-			if (!(--n)) { break; }
 		}
 		return a;
 	}
 
-	BasicBlock* currentBlock() { return blocks.back()->block; }
+	BasicBlock* currentBlock() { return builder.GetInsertBlock(); }
+
+	/* mem2reg only promotes allocas in the entry block, and there a loop doesn't grow the stack with them */
+	AllocaInst* entryAlloca(Type* type, const std::string& name, Value* count = nullptr)
+	{
+		auto& entry = currentBlock()->getParent()->getEntryBlock();
+		IRBuilder<> atEntry(&entry, entry.begin());
+		return atEntry.CreateAlloca(type, count, name);
+	}
 
 	void pushBlock(BasicBlock* block, std::string name, bool transpent = false, bool function = false)
 	{
@@ -133,6 +345,7 @@ public:
 		blocks.back()->name = name;
 		blocks.back()->isTranspent = transpent;
 		blocks.back()->isFunction = function;
+		builder.SetInsertPoint(block);
 	}
 
 	void popBlock()
@@ -141,6 +354,7 @@ public:
 		dclog << debug_stream::verbose << "poping block " + top->name << ", " + top->block->getName().str() << ", transpent:" << top->isTranspent << ", addr:" << top->block << std::endl;
 		blocks.pop_back();
 		delete top;
+		if (!blocks.empty()) builder.SetInsertPoint(blocks.back()->block);
 	}
 
 	void popBlockUntil(BasicBlock* b)
@@ -153,6 +367,7 @@ public:
 			blocks.pop_back();
 			delete top;
 		}
+		builder.SetInsertPoint(b);
 		dclog << debug_stream::indent(2, -1);
 		dclog << "until basic block " << b << std::endl;
 	}
@@ -160,3 +375,6 @@ public:
 	void setCurrentReturnValue(Value* value) { blocks.back()->returnValue = value; }
 	Value* getCurrentReturnValue() { return blocks.back()->returnValue; }
 };
+
+/* Returns an LLVM type based on the identifier */
+Type* typeOf(const NIdentifier& type, CodeGenContext& context);
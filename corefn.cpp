@@ -1,5 +1,6 @@
 #include "codegen.h"
 #include "node.h"
+#include "runtime.h"
 
 using namespace std;
 
@@ -7,25 +8,26 @@ extern int yyparse();
 extern NBlock* programBlock;
 
 
-Function* createPrintfFunction(CodeGenContext& context)
+/* Declares the runtime function that formats and buffers values of type arg */
+Function* createRuntimeOutputFunction(CodeGenContext& context, const char* name, Type* arg)
 {
-	vector<Type*> printf_arg_types;
-	printf_arg_types.push_back(Type::getInt8PtrTy(context.llvmContext)); //char*
+	vector<Type*> output_arg_types;
+	output_arg_types.push_back(arg);
 
-	auto printf_type =
+	auto output_type =
 			FunctionType::get(
-				Type::getInt32Ty(context.llvmContext), makeArrayRef(printf_arg_types), true);
+				Type::getVoidTy(context.llvmContext), makeArrayRef(output_arg_types), false);
 
 	auto func = Function::Create(
-		printf_type, Function::ExternalLinkage,
-		Twine("printf"),
+		output_type, Function::ExternalLinkage,
+		Twine(name),
 		context.module
 	);
 	func->setCallingConv(CallingConv::C);
 	return func;
 }
 
-void createEchoFunction(CodeGenContext& context, Function* printfFn)
+void createEchoFunction(CodeGenContext& context, Function* outputFn)
 {
 	vector<Type*> echo_arg_types;
 	echo_arg_types.push_back(Type::getInt64Ty(context.llvmContext));
@@ -42,34 +44,16 @@ void createEchoFunction(CodeGenContext& context, Function* printfFn)
 	auto bblock = BasicBlock::Create(context.llvmContext, "entry", func, nullptr);
 	context.pushBlock(bblock, "echo");
 
-	auto constValue = "%d\n";
-	auto format_const = ConstantDataArray::getString(context.llvmContext, constValue);
-	auto var =
-			new GlobalVariable(
-				*context.module, ArrayType::get(IntegerType::get(context.llvmContext, 8), strlen(constValue) + 1),
-				true, GlobalValue::PrivateLinkage, format_const, ".str");
-	auto zero =
-			Constant::getNullValue(IntegerType::getInt32Ty(context.llvmContext));
-
-	vector<Constant*> indices;
-	indices.push_back(zero);
-	indices.push_back(zero);
-	auto var_ref = ConstantExpr::getGetElementPtr(
-		ArrayType::get(IntegerType::get(context.llvmContext, 8), strlen(constValue) + 1), var, indices);
-	vector<Value*> args;
-	args.push_back(var_ref);
-
 	auto argsValues = func->arg_begin();
 	auto toPrint = &*argsValues;
 	toPrint->setName("toPrint");
-	args.push_back(toPrint);
 
-	CallInst::Create(printfFn, makeArrayRef(args), "", bblock);
-	ReturnInst::Create(context.llvmContext, toPrint, bblock);
+	context.builder.CreateCall(outputFn, toPrint);
+	context.builder.CreateRet(toPrint);
 	context.popBlock();
 }
 
-void createEchodFunction(CodeGenContext& context, Function* printfFn)
+void createEchodFunction(CodeGenContext& context, Function* outputFn)
 {
 	vector<Type*> echo_arg_types;
 	echo_arg_types.push_back(Type::getDoubleTy(context.llvmContext));
@@ -86,35 +70,17 @@ void createEchodFunction(CodeGenContext& context, Function* printfFn)
 	auto bblock = BasicBlock::Create(context.llvmContext, "entry", func, nullptr);
 	context.pushBlock(bblock, "echod");
 
-	auto constValue = "%lf\n";
-	auto format_const = ConstantDataArray::getString(context.llvmContext, constValue);
-	auto var =
-			new GlobalVariable(
-				*context.module, ArrayType::get(IntegerType::get(context.llvmContext, 8), strlen(constValue) + 1),
-				true, GlobalValue::PrivateLinkage, format_const, ".str");
-	auto zero =
-			Constant::getNullValue(IntegerType::getInt32Ty(context.llvmContext));
-
-	vector<Constant*> indices;
-	indices.push_back(zero);
-	indices.push_back(zero);
-	auto var_ref = ConstantExpr::getGetElementPtr(
-		nullptr, var, indices);
-	vector<Value*> args;
-	args.push_back(var_ref);
-
 	auto argsValues = func->arg_begin();
 	auto toPrint = &*argsValues;
 	toPrint->setName("toPrint");
-	args.push_back(toPrint);
-	CallInst::Create(printfFn, makeArrayRef(args), "", bblock);
-	ReturnInst::Create(context.llvmContext, toPrint, bblock);
+	context.builder.CreateCall(outputFn, toPrint);
+	context.builder.CreateRet(toPrint);
 	context.popBlock();
 }
 
 void createCoreFunctions(CodeGenContext& context)
 {
-	auto printfFn = createPrintfFunction(context);
-	createEchoFunction(context, printfFn);
-	createEchodFunction(context, printfFn);
+	registerRuntimeSymbols();
+	createEchoFunction(context, createRuntimeOutputFunction(context, "toy_echo_i64", Type::getInt64Ty(context.llvmContext)));
+	createEchodFunction(context, createRuntimeOutputFunction(context, "toy_echo_f64", Type::getDoubleTy(context.llvmContext)));
 }
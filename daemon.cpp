@@ -0,0 +1,183 @@
+#include "codegen.h"
+#include "node.h"
+#include "astcache.h"
+#ifndef _WIN32
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+int runDaemon(CodeGenContext& context, const std::string& path)
+{
+	std::cerr << "The compile server needs Unix domain sockets and fork" << std::endl;
+	return 1;
+}
+
+#else
+
+namespace
+{
+	bool readAll(int fd, std::string& data)
+	{
+		char buffer[4096];
+		ssize_t n;
+		while ((n = read(fd, buffer, sizeof buffer)) > 0) {
+			data.append(buffer, n);
+		}
+		return n == 0;
+	}
+
+	/* A request is a line of options followed by the script; the client's stdout and
+	   stderr come along with its first bytes so the script writes straight to them */
+	bool receiveRequest(int client, std::string& request, int fds[2])
+	{
+		char buffer[4096];
+		char control[CMSG_SPACE(2 * sizeof(int))];
+		iovec iov{buffer, sizeof buffer};
+		msghdr message{};
+		message.msg_iov = &iov;
+		message.msg_iovlen = 1;
+		message.msg_control = control;
+		message.msg_controllen = sizeof control;
+		auto n = recvmsg(client, &message, 0);
+		if (n <= 0) return false;
+		auto header = CMSG_FIRSTHDR(&message);
+		if (header == nullptr || header->cmsg_type != SCM_RIGHTS || header->cmsg_len != CMSG_LEN(2 * sizeof(int))) return false;
+		std::memcpy(fds, CMSG_DATA(header), 2 * sizeof(int));
+		request.assign(buffer, n);
+		return readAll(client, request);
+	}
+
+	/* Compiles and runs one request in a copy of the warm context, exactly like main would */
+	[[noreturn]] void serve(CodeGenContext& context, const std::string& request, const std::string& cacheDirectory)
+	{
+		auto split = request.find('\n');
+		auto options = request.substr(0, split);
+		auto source = split == std::string::npos ? std::string() : request.substr(split + 1);
+		auto compileOnly = false;
+		auto optimize = false;
+		auto logLevel = 4;
+		std::istringstream words(options);
+		std::string word;
+		while (words >> word) {
+			if (word == "-c" || word == "--compile") compileOnly = true;
+			if (word == "-O" || word == "--optimize") optimize = true;
+			if (word.size() == 6 && word.find("--log") == 0 && word[5] >= '0' && word[5] <= '4') logLevel = word[5] - '0';
+		}
+		context.dclog.max_level = debug_stream::level(logLevel);
+
+		auto programBlock = parseSource(source, cacheDirectory, context.ast);
+
+		MD5 hash;
+		hash.update(options);
+		hash.update(source);
+		MD5::MD5Result digest;
+		hash.final(digest);
+		context.module->setModuleIdentifier(digest.digest().str().str());
+		ObjectFileCache cache(cacheDirectory);
+		context.optimize = optimize;
+		context.objectCache = &cache;
+		context.separateFunctions = true;
+
+		context.generateCode(*programBlock);
+		if (!compileOnly) {
+			auto val = context.runCode();
+			(context.llclog << val.IntVal.getSExtValue() << "\n").flush();
+		}
+		exit(0);
+	}
+
+	/* Runs the request in a child of its own, since errors exit, and reports how that ended */
+	[[noreturn]] void handle(CodeGenContext& context, int client, const std::string& cacheDirectory)
+	{
+		std::string request;
+		int fds[2];
+		if (!receiveRequest(client, request, fds)) {
+			_exit(1);
+		}
+		auto runner = fork();
+		if (runner == 0) {
+			dup2(fds[0], 1);
+			dup2(fds[1], 2);
+			close(fds[0]);
+			close(fds[1]);
+			close(client);
+			serve(context, request, cacheDirectory);
+		}
+		close(fds[0]);
+		close(fds[1]);
+		auto status = 0;
+		if (runner < 0 || waitpid(runner, &status, 0) < 0) {
+			status = 1 << 8;
+		}
+		auto code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+		auto reply = "exit " + std::to_string(code) + "\n";
+		if (write(client, reply.data(), reply.size()) < 0) {
+			_exit(1);
+		}
+		_exit(0);
+	}
+}
+
+/* Compile server: targets are initialized and the core functions generated once, then every
+   request is served by a fork of this process, which hands it a warm copy of the context */
+int runDaemon(CodeGenContext& context, const std::string& path)
+{
+	auto cacheDirectory = path + ".cache";
+	sys::fs::remove_directories(cacheDirectory, true);
+	if (auto ec = sys::fs::create_directories(cacheDirectory)) {
+		std::cerr << "Can't create " << cacheDirectory << ": " << ec.message() << std::endl;
+		return 1;
+	}
+
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof address.sun_path) {
+		std::cerr << "Socket path too long: " << path << std::endl;
+		return 1;
+	}
+	path.copy(address.sun_path, path.size());
+	auto server = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(path.c_str());
+	if (server < 0 || bind(server, reinterpret_cast<sockaddr*>(&address), sizeof address) < 0 || listen(server, 16) < 0) {
+		std::cerr << "Can't listen on " << path << ": " << std::strerror(errno) << std::endl;
+		return 1;
+	}
+	signal(SIGCHLD, SIG_IGN); /* handlers report to their clients, nobody waits for them */
+	context.dclog << debug_stream::info << "Listening on " << path << std::endl;
+
+	while (true) {
+		auto client = accept(server, nullptr, nullptr);
+		if (client < 0) {
+			if (errno == EINTR) continue;
+			std::cerr << "accept failed: " << std::strerror(errno) << std::endl;
+			break;
+		}
+		ObjectFileCache::prune(cacheDirectory);
+		/* Nothing buffered here may be written again by the children */
+		std::clog.flush();
+		outs().flush();
+		std::fflush(nullptr);
+		auto handler = fork();
+		if (handler == 0) {
+			close(server);
+			signal(SIGCHLD, SIG_DFL);
+			handle(context, client, cacheDirectory);
+		}
+		close(client);
+	}
+	close(server);
+	unlink(path.c_str());
+	return 1;
+}
+
+#endif
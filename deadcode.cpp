@@ -0,0 +1,76 @@
+#include "deadcode.h"
+#include "codegen.h"
+#include "node.h"
+#include <algorithm>
+
+int removeDeadFunctions(NBlock& root, CodeGenContext& context)
+{
+	const auto none = FlatAst::none;
+	auto& ast = context.ast;
+	auto top = ast.indexOf(&root);
+	std::vector<uint32_t> parents(ast.size(), none);
+	std::map<std::string, std::vector<uint32_t>> functions;
+	for (uint32_t i = 0; i < ast.size(); ++i) {
+		auto ops = ast.operandsOf(i);
+		for (uint32_t k = 0; k < ops.size(); ++k) {
+			if (FlatAst::operandKind(ast.tags[i], k) == FlatAst::Child && ops[k] != none) parents[ops[k]] = i;
+		}
+		if (ast.tags[i] == NodeKind::FunctionDeclaration) functions[ast.string(ops[2]).str()].push_back(i);
+	}
+
+	/* The script's own code is reached, a function once a call it can resolve to is. Later inputs of an
+	   incremental session may call any top-level function, so those are reached as well. */
+	std::vector<bool> reached(ast.size(), false);
+	std::vector<uint32_t> pending{top};
+	for (auto const& named : functions) {
+		for (auto k : named.second) {
+			if (context.incremental && !ast.operandsOf(k)[0]) {
+				reached[k] = true;
+				pending.push_back(k);
+			}
+		}
+	}
+	while (!pending.empty()) {
+		auto scope = pending.back();
+		pending.pop_back();
+		for (auto i = int64_t(scope); i >= int64_t(ast.starts[scope]); --i) {
+			/* Functions declared in here are only reached through their own calls */
+			if (i != scope && ast.tags[i] == NodeKind::FunctionDeclaration) {
+				i = ast.starts[i];
+				continue;
+			}
+			if (ast.tags[i] != NodeKind::MethodCall) continue;
+			auto found = functions.find(ast.string(ast.operandsOf(static_cast<uint32_t>(i))[0]).str());
+			if (found == functions.end()) continue;
+			for (auto k : found->second) {
+				/* A top-level function is found from anywhere, a local one only under the block declaring it */
+				auto block = parents[k];
+				auto visible = !ast.operandsOf(k)[0] || (ast.starts[block] <= i && i <= int64_t(block));
+				if (visible && !reached[k]) {
+					reached[k] = true;
+					pending.push_back(k);
+				}
+			}
+		}
+	}
+
+	/* Outermost first, whatever is declared in a dropped function goes with it */
+	std::vector<bool> dropped(ast.size(), false);
+	auto removed = 0;
+	for (auto k = int64_t(ast.size()) - 1; k >= 0; --k) {
+		if (ast.tags[k] != NodeKind::FunctionDeclaration || reached[k]) continue;
+		auto block = parents[k];
+		if (block == none || ast.tags[block] != NodeKind::Block) continue;
+		auto inside = false;
+		for (auto p = block; p != none && !inside; p = parents[p]) inside = dropped[p];
+		if (inside) continue;
+		auto& statements = cast<NBlock>(ast.nodes[block])->statements;
+		/* The last statement is the value of a function body */
+		if (block != top && statements.back() == ast.nodes[k]) continue;
+		context.dclog << debug_stream::info << "Removing unreachable function " << ast.string(ast.operandsOf(k)[2]).str() << std::endl;
+		statements.erase(std::remove(statements.begin(), statements.end(), ast.nodes[k]), statements.end());
+		dropped[k] = true;
+		++removed;
+	}
+	return removed;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+class NBlock;
+class CodeGenContext;
+
+/* Drops the function declarations under root that no call reachable from the top-level code can resolve to,
+   before any IR is built for them. Returns how many it dropped. */
+int removeDeadFunctions(NBlock& root, CodeGenContext& context);
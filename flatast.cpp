@@ -0,0 +1,619 @@
+#include "flatast.h"
+#include "node.h"
+#include "parser.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	/* Operators are stored by their position here, token numbers change with the grammar */
+	const int operators[] = {TPLUS, TMINUS, TMUL, TDIV, TPOW, TCEQ, TCNE, TCLT, TCLE, TCGT, TCGE, TNOT, TAND, TOR};
+	const uint32_t operatorCount = sizeof operators / sizeof operators[0];
+}
+
+FlatAst::OperandKind FlatAst::operandKind(NodeKind tag, uint32_t position)
+{
+	switch (tag) {
+	case NodeKind::Bool:
+		return Value;
+	case NodeKind::Integer:
+	case NodeKind::Double:
+		return Literal;
+	case NodeKind::Identifier:
+	case NodeKind::ArrayLength:
+		return String;
+	case NodeKind::MethodCall:
+	case NodeKind::Assignment:
+	case NodeKind::ArrayIndex:
+	case NodeKind::ArrayAssignment:
+	case NodeKind::Cast:
+		return position == 0 ? String : Child;
+	case NodeKind::BinaryOperator:
+		return position == 0 ? Value : Child;
+	case NodeKind::ForBlock:
+		/* id, from, to, step, body, then name and value of every pragma */
+		if (position == 0) return String;
+		if (position < 5) return Child;
+		return position % 2 ? String : Literal;
+	case NodeKind::ParallelFor:
+		/* id, from, to, body, reduction operator and variable */
+		if (position == 0 || position > 3) return String;
+		return Child;
+	case NodeKind::VariableDefinition:
+		/* type, name, initializer, whether it is a let */
+		if (position == 3) return Value;
+		return position < 2 ? String : Child;
+	case NodeKind::ArrayDefinition:
+	case NodeKind::ExternDeclaration:
+		return position < 2 ? String : Child;
+	case NodeKind::FunctionDeclaration:
+		/* local, type, name, body, arguments */
+		if (position == 0) return Value;
+		return position < 3 ? String : Child;
+	case NodeKind::Match:
+		/* subject, the _ arm, then label and value of every other arm */
+		if (position < 2) return Child;
+		return position % 2 ? Child : Literal;
+	default:
+		return Child;
+	}
+}
+
+int FlatAst::operatorToken(uint32_t op)
+{
+	return op < operatorCount ? operators[op] : 0;
+}
+
+void FlatAst::clear()
+{
+	*this = FlatAst();
+}
+
+uint32_t FlatAst::indexOf(Node* node)
+{
+	auto found = indices.find(node);
+	return found != indices.end() ? found->second : flatten(node);
+}
+
+uint32_t FlatAst::intern(const std::string& s)
+{
+	auto found = stringIds.find(s);
+	if (found != stringIds.end()) return found->second;
+	chars += s;
+	offsets.push_back(static_cast<uint32_t>(chars.size()));
+	return stringIds[s] = strings() - 1;
+}
+
+uint32_t FlatAst::literal(uint64_t value)
+{
+	literals.push_back(value);
+	return static_cast<uint32_t>(literals.size() - 1);
+}
+
+uint32_t FlatAst::emit(NodeKind tag, uint32_t start, Node* node, std::vector<uint32_t> const& ops)
+{
+	tags.push_back(tag);
+	operands.insert(operands.end(), ops.begin(), ops.end());
+	first.push_back(static_cast<uint32_t>(operands.size()));
+	starts.push_back(start);
+	nodes.push_back(node);
+	return indices[node] = size() - 1;
+}
+
+uint32_t FlatAst::flatten(Node* node)
+{
+	if (node == nullptr) return none;
+	auto start = size();
+	switch (node->kind) {
+	case NodeKind::Bool: {
+		auto boolean = static_cast<NBool*>(node);
+		return emit(NodeKind::Bool, start, node, {boolean->value});
+	}
+	case NodeKind::Integer: {
+		auto integer = static_cast<NInteger*>(node);
+		return emit(NodeKind::Integer, start, node, {literal(static_cast<uint64_t>(integer->value))});
+	}
+	case NodeKind::Double: {
+		auto real = static_cast<NDouble*>(node);
+		uint64_t bits;
+		std::memcpy(&bits, &real->value, sizeof bits);
+		return emit(NodeKind::Double, start, node, {literal(bits)});
+	}
+	case NodeKind::Identifier: {
+		auto ident = static_cast<NIdentifier*>(node);
+		return emit(NodeKind::Identifier, start, node, {intern(ident->name)});
+	}
+	case NodeKind::MethodCall: {
+		auto call = static_cast<NMethodCall*>(node);
+		std::vector<uint32_t> ops{intern(call->id.name)};
+		for (auto arg : call->arguments) ops.push_back(flatten(arg));
+		return emit(NodeKind::MethodCall, start, node, ops);
+	}
+	case NodeKind::BinaryOperator: {
+		auto binop = static_cast<NBinaryOperator*>(node);
+		auto op = static_cast<uint32_t>(std::find(operators, operators + operatorCount, binop->op) - operators);
+		auto lhs = flatten(binop->lhs);
+		auto rhs = flatten(binop->rhs);
+		return emit(NodeKind::BinaryOperator, start, node, {op, lhs, rhs});
+	}
+	case NodeKind::Assignment: {
+		auto assn = static_cast<NAssignment*>(node);
+		return emit(NodeKind::Assignment, start, node, {intern(assn->lhs.name), flatten(assn->rhs)});
+	}
+	case NodeKind::ArrayIndex: {
+		auto index = static_cast<NArrayIndex*>(node);
+		return emit(NodeKind::ArrayIndex, start, node, {intern(index->id.name), flatten(index->index)});
+	}
+	case NodeKind::ArrayAssignment: {
+		auto assn = static_cast<NArrayAssignment*>(node);
+		auto index = flatten(assn->index);
+		auto rhs = flatten(assn->rhs);
+		return emit(NodeKind::ArrayAssignment, start, node, {intern(assn->id.name), index, rhs});
+	}
+	case NodeKind::ArrayLength: {
+		auto length = static_cast<NArrayLength*>(node);
+		return emit(NodeKind::ArrayLength, start, node, {intern(length->id.name)});
+	}
+	case NodeKind::Block: {
+		auto block = static_cast<NBlock*>(node);
+		std::vector<uint32_t> ops;
+		for (auto stmt : block->statements) ops.push_back(flatten(stmt));
+		return emit(NodeKind::Block, start, node, ops);
+	}
+	case NodeKind::ExpressionStatement: {
+		auto stmt = static_cast<NExpressionStatement*>(node);
+		return emit(NodeKind::ExpressionStatement, start, node, {flatten(stmt->expression)});
+	}
+	case NodeKind::ReturnStatement: {
+		auto ret = static_cast<NReturnStatement*>(node);
+		return emit(NodeKind::ReturnStatement, start, node, {flatten(ret->expression)});
+	}
+	case NodeKind::IfBlock: {
+		auto ifb = static_cast<NIfBlock*>(node);
+		auto cond = flatten(ifb->cond);
+		auto thenblock = flatten(ifb->thenblock);
+		auto elseblock = flatten(ifb->elseblock);
+		return emit(NodeKind::IfBlock, start, node, {cond, thenblock, elseblock});
+	}
+	case NodeKind::WhileBlock: {
+		auto whileb = static_cast<NWhileBlock*>(node);
+		auto cond = flatten(whileb->cond);
+		auto doblock = flatten(&whileb->doblock);
+		return emit(NodeKind::WhileBlock, start, node, {cond, doblock});
+	}
+	case NodeKind::ForBlock: {
+		auto forb = static_cast<NForBlock*>(node);
+		auto from = flatten(forb->from);
+		auto to = flatten(forb->to);
+		auto step = flatten(forb->step);
+		auto doblock = flatten(&forb->doblock);
+		std::vector<uint32_t> ops{intern(forb->id.name), from, to, step, doblock};
+		for (auto const& pragma : forb->pragmas) {
+			ops.push_back(intern(pragma.first));
+			ops.push_back(literal(static_cast<uint64_t>(pragma.second)));
+		}
+		return emit(NodeKind::ForBlock, start, node, ops);
+	}
+	case NodeKind::ParallelFor: {
+		auto pfor = static_cast<NParallelFor*>(node);
+		auto from = flatten(pfor->from);
+		auto to = flatten(pfor->to);
+		auto doblock = flatten(&pfor->doblock);
+		return emit(NodeKind::ParallelFor, start, node, {
+			intern(pfor->id.name), from, to, doblock,
+			pfor->reduction ? intern(pfor->reduceOp) : none,
+			pfor->reduction ? intern(pfor->reduction->name) : none
+		});
+	}
+	case NodeKind::VariableDefinition: {
+		auto var = static_cast<NVariableDefinition*>(node);
+		auto assignment = flatten(var->assignmentExpr);
+		return emit(NodeKind::VariableDefinition, start, node, {intern(var->type.name), intern(var->id.name), assignment, var->immutable});
+	}
+	case NodeKind::ArrayDefinition: {
+		auto arr = static_cast<NArrayDefinition*>(node);
+		auto size = flatten(arr->size);
+		auto assignment = flatten(arr->assignmentExpr);
+		return emit(NodeKind::ArrayDefinition, start, node, {intern(arr->type.name), intern(arr->id.name), size, assignment});
+	}
+	case NodeKind::ExternDeclaration: {
+		auto ext = static_cast<NExternDeclaration*>(node);
+		std::vector<uint32_t> ops{intern(ext->type.name), intern(ext->id.name)};
+		for (auto arg : ext->arguments) ops.push_back(flatten(arg));
+		return emit(NodeKind::ExternDeclaration, start, node, ops);
+	}
+	case NodeKind::FunctionDeclaration: {
+		auto fn = static_cast<NFunctionDeclaration*>(node);
+		auto block = flatten(&fn->block);
+		std::vector<uint32_t> ops{fn->local, intern(fn->type.name), intern(fn->id.name), block};
+		for (auto arg : fn->arguments) ops.push_back(flatten(arg));
+		return emit(NodeKind::FunctionDeclaration, start, node, ops);
+	}
+	case NodeKind::Cast: {
+		auto conversion = static_cast<NCast*>(node);
+		return emit(NodeKind::Cast, start, node, {intern(conversion->target.name), flatten(conversion->expression)});
+	}
+	case NodeKind::Match: {
+		auto match = static_cast<NMatch*>(node);
+		std::vector<uint32_t> ops{flatten(match->subject), none};
+		for (auto const& arm : match->cases) {
+			ops.push_back(literal(static_cast<uint64_t>(arm.first)));
+			ops.push_back(flatten(arm.second));
+		}
+		ops[1] = flatten(match->otherwise);
+		return emit(NodeKind::Match, start, node, ops);
+	}
+	default:
+		llvm_unreachable("Node can't be flattened");
+	}
+}
+
+NBlock* FlatAst::rebuild()
+{
+	if (tags.empty() || first.size() != tags.size() + 1 || first[0] != 0 || first.back() != operands.size()) return nullptr;
+	if (offsets.empty() || offsets[0] != 0 || offsets.back() != chars.size()) return nullptr;
+	for (uint32_t i = 0; i + 1 < offsets.size(); ++i) {
+		if (offsets[i] > offsets[i + 1]) return nullptr;
+	}
+	starts.assign(size(), 0);
+	nodes.assign(size(), nullptr);
+	indices.clear();
+	stringIds.clear();
+	for (uint32_t i = 0; i < size(); ++i) {
+		if (tags[i] == NodeKind::VariableDeclaration || tags[i] > NodeKind::Match || first[i] > first[i + 1]) return nullptr;
+		auto start = i;
+		auto ops = operandsOf(i);
+		for (uint32_t k = 0; k < ops.size(); ++k) {
+			switch (operandKind(tags[i], k)) {
+			case Child:
+				if (ops[k] == none) break;
+				if (ops[k] >= i) return nullptr;
+				start = std::min(start, starts[ops[k]]);
+				break;
+			case String:
+				if (ops[k] != none && ops[k] >= strings()) return nullptr;
+				break;
+			case Literal:
+				if (ops[k] >= literals.size()) return nullptr;
+				break;
+			case Value:
+				break;
+			}
+		}
+		starts[i] = start;
+		auto ok = true;
+		nodes[i] = build(i, ok);
+		if (!ok) return nullptr;
+		indices[nodes[i]] = i;
+	}
+	return dyn_cast<NBlock>(nodes.back());
+}
+
+Node* FlatAst::clone(uint32_t node, const std::map<std::string, std::string>& renames)
+{
+	/* Builds the subtree again in place, then puts back the nodes of the tree it came from */
+	std::vector<Node*> saved(nodes.begin() + starts[node], nodes.begin() + node + 1);
+	this->renames = &renames;
+	auto ok = true;
+	for (auto i = starts[node]; i <= node && ok; ++i) {
+		nodes[i] = build(i, ok);
+	}
+	this->renames = nullptr;
+	auto copy = nodes[node];
+	std::copy(saved.begin(), saved.end(), nodes.begin() + starts[node]);
+	return ok ? copy : nullptr;
+}
+
+/* Operands are in range already, this checks the node kinds of the children and the operand counts */
+Node* FlatAst::build(uint32_t node, bool& ok)
+{
+	auto ops = operandsOf(node);
+	auto count = static_cast<uint32_t>(ops.size());
+	auto operand = [&](uint32_t i) {
+		if (i >= count) ok = false;
+		return i < count ? ops[i] : none;
+	};
+	auto ident = [&](uint32_t i) -> NIdentifier& {
+		auto id = operand(i);
+		if (id == none) ok = false;
+		auto name = id == none ? std::string() : string(id).str();
+		if (renames) {
+			auto renamed = renames->find(name);
+			if (renamed != renames->end()) name = renamed->second;
+		}
+		return *new NIdentifier(name);
+	};
+	auto literalAt = [&](uint32_t i) {
+		auto id = operand(i);
+		return id < literals.size() ? literals[id] : 0;
+	};
+	/* Optional children are none, required ones have to be there */
+	auto optional = [&](uint32_t i) {
+		auto id = operand(i);
+		return id == none ? nullptr : nodes[id];
+	};
+	auto expression = [&](uint32_t i) {
+		auto child = dyn_cast_or_null<NExpression>(optional(i));
+		if (!child) ok = false;
+		return child;
+	};
+	auto block = [&](uint32_t i) {
+		auto child = dyn_cast_or_null<NBlock>(optional(i));
+		if (!child) ok = false;
+		return child;
+	};
+	auto variable = [&](uint32_t i) {
+		auto child = dyn_cast_or_null<NVariableDefinition>(optional(i));
+		if (!child) ok = false;
+		return child;
+	};
+
+	switch (tags[node]) {
+	case NodeKind::Bool:
+		return new NBool(operand(0) != 0);
+	case NodeKind::Integer:
+		return new NInteger(static_cast<int64_t>(literalAt(0)));
+	case NodeKind::Double: {
+		auto bits = literalAt(0);
+		double value;
+		std::memcpy(&value, &bits, sizeof value);
+		return new NDouble(value);
+	}
+	case NodeKind::Identifier:
+		return &ident(0);
+	case NodeKind::MethodCall: {
+		ExpressionList arguments;
+		for (uint32_t i = 1; i < count; ++i) arguments.push_back(expression(i));
+		return new NMethodCall(ident(0), arguments);
+	}
+	case NodeKind::BinaryOperator: {
+		auto op = operatorToken(operand(0));
+		auto lhs = expression(1);
+		auto rhs = expression(2);
+		if (!ok || op == 0) break;
+		return new NBinaryOperator(*lhs, op, *rhs);
+	}
+	case NodeKind::Assignment: {
+		auto rhs = expression(1);
+		if (!ok) break;
+		return new NAssignment(ident(0), *rhs);
+	}
+	case NodeKind::ArrayIndex: {
+		auto index = expression(1);
+		if (!ok) break;
+		return new NArrayIndex(ident(0), *index);
+	}
+	case NodeKind::ArrayAssignment: {
+		auto index = expression(1);
+		auto rhs = expression(2);
+		if (!ok) break;
+		return new NArrayAssignment(ident(0), *index, *rhs);
+	}
+	case NodeKind::ArrayLength:
+		return new NArrayLength(ident(0));
+	case NodeKind::Block: {
+		auto result = new NBlock();
+		for (uint32_t i = 0; i < count; ++i) {
+			auto stmt = dyn_cast_or_null<NStatement>(optional(i));
+			if (!stmt) ok = false;
+			result->statements.push_back(stmt);
+		}
+		return result;
+	}
+	case NodeKind::ExpressionStatement: {
+		auto expr = expression(0);
+		if (!ok) break;
+		return new NExpressionStatement(*expr);
+	}
+	case NodeKind::ReturnStatement: {
+		auto expr = expression(0);
+		if (!ok) break;
+		return new NReturnStatement(*expr);
+	}
+	case NodeKind::IfBlock: {
+		auto cond = expression(0);
+		auto thenblock = expression(1);
+		auto elseblock = expression(2);
+		if (!ok) break;
+		return new NIfBlock(*cond, *thenblock, *elseblock);
+	}
+	case NodeKind::WhileBlock: {
+		auto cond = expression(0);
+		auto doblock = block(1);
+		if (!ok) break;
+		return new NWhileBlock(*cond, *doblock);
+	}
+	case NodeKind::ForBlock: {
+		auto from = expression(1);
+		auto to = expression(2);
+		auto step = dyn_cast_or_null<NExpression>(optional(3));
+		auto doblock = block(4);
+		if (!ok || count % 2 == 0 || (operand(3) != none && !step)) break;
+		auto forb = new NForBlock(ident(0), *from, *to, step, *doblock);
+		for (uint32_t i = 5; i < count; i += 2) {
+			if (operand(i) == none) ok = false;
+			else forb->pragmas[string(operand(i)).str()] = static_cast<int64_t>(literalAt(i + 1));
+		}
+		return forb;
+	}
+	case NodeKind::ParallelFor: {
+		auto from = expression(1);
+		auto to = expression(2);
+		auto doblock = block(3);
+		if (!ok || count != 6) break;
+		if (operand(5) == none) {
+			return new NParallelFor(ident(0), *from, *to, *doblock);
+		}
+		if (operand(4) == none) break;
+		return new NParallelFor(ident(0), *from, *to, string(operand(4)).str(), &ident(5), *doblock);
+	}
+	case NodeKind::VariableDefinition: {
+		auto assignment = dyn_cast_or_null<NExpression>(optional(2));
+		if (count != 4 || (operand(2) != none && !assignment)) break;
+		return new NVariableDefinition(ident(0), ident(1), assignment, operand(3) != 0);
+	}
+	case NodeKind::ArrayDefinition: {
+		auto size = expression(2);
+		auto assignment = dyn_cast_or_null<NExpression>(optional(3));
+		if (!ok || count != 4 || (operand(3) != none && !assignment)) break;
+		return new NArrayDefinition(ident(0), ident(1), *size, assignment);
+	}
+	case NodeKind::ExternDeclaration: {
+		VariableList arguments;
+		for (uint32_t i = 2; i < count; ++i) arguments.push_back(variable(i));
+		return new NExternDeclaration(ident(0), ident(1), arguments);
+	}
+	case NodeKind::FunctionDeclaration: {
+		auto body = block(3);
+		VariableList arguments;
+		for (uint32_t i = 4; i < count; ++i) arguments.push_back(variable(i));
+		if (!ok) break;
+		return new NFunctionDeclaration(ident(1), ident(2), arguments, *body, operand(0) != 0);
+	}
+	case NodeKind::Cast: {
+		auto expr = expression(1);
+		if (!ok) break;
+		return new NCast(ident(0), *expr);
+	}
+	case NodeKind::Match: {
+		auto subject = expression(0);
+		auto otherwise = expression(1);
+		std::vector<std::pair<int64_t, NExpression*>> cases;
+		for (uint32_t i = 2; i + 1 < count; i += 2) {
+			cases.push_back(std::make_pair(static_cast<int64_t>(literalAt(i)), expression(i + 1)));
+		}
+		if (!ok || count % 2) break;
+		auto match = new NMatch();
+		match->subject = subject;
+		match->otherwise = otherwise;
+		match->cases = std::move(cases);
+		return match;
+	}
+	default:
+		break;
+	}
+	ok = false;
+	return nullptr;
+}
+
+/* Walks the subtree backwards so the parts that don't count can be skipped whole */
+void collectNames(const FlatAst& ast, uint32_t node, std::set<std::string>& vars, std::set<std::string>& calls, std::set<std::string>& defined)
+{
+	if (node == FlatAst::none) return;
+	for (auto i = int64_t(node); i >= int64_t(ast.starts[node]); --i) {
+		auto ops = ast.operandsOf(static_cast<uint32_t>(i));
+		switch (ast.tags[i]) {
+		case NodeKind::Identifier:
+		case NodeKind::Assignment:
+		case NodeKind::ArrayIndex:
+		case NodeKind::ArrayAssignment:
+		case NodeKind::ArrayLength:
+			vars.insert(ast.string(ops[0]).str());
+			break;
+		case NodeKind::MethodCall:
+			calls.insert(ast.string(ops[0]).str());
+			break;
+		case NodeKind::ForBlock:
+			defined.insert(ast.string(ops[0]).str());
+			break;
+		case NodeKind::ParallelFor:
+			defined.insert(ast.string(ops[0]).str());
+			if (ops[5] != FlatAst::none) vars.insert(ast.string(ops[5]).str());
+			break;
+		case NodeKind::VariableDefinition:
+		case NodeKind::ArrayDefinition:
+			defined.insert(ast.string(ops[1]).str());
+			break;
+		case NodeKind::FunctionDeclaration:
+			defined.insert(ast.string(ops[2]).str());
+			break;
+		case NodeKind::ExternDeclaration:
+			/* Its parameters name nothing in here */
+			i = ast.starts[i];
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+void collectWrites(const FlatAst& ast, uint32_t node, std::set<std::string>& written)
+{
+	if (node == FlatAst::none) return;
+	/* Calls are resolved by name only, so every local function of that name counts */
+	std::map<std::string, std::vector<uint32_t>> localFunctions;
+	for (uint32_t i = 0; i < ast.size(); ++i) {
+		auto ops = ast.operandsOf(i);
+		if (ast.tags[i] == NodeKind::FunctionDeclaration && ops[0]) localFunctions[ast.string(ops[2]).str()].push_back(i);
+	}
+	std::vector<uint32_t> pending{node};
+	std::set<uint32_t> seen{node};
+	while (!pending.empty()) {
+		auto root = pending.back();
+		pending.pop_back();
+		for (auto i = int64_t(root); i >= int64_t(ast.starts[root]); --i) {
+			auto ops = ast.operandsOf(static_cast<uint32_t>(i));
+			switch (ast.tags[i]) {
+			case NodeKind::Assignment:
+				written.insert(ast.string(ops[0]).str());
+				break;
+			case NodeKind::ParallelFor:
+				if (ops[5] != FlatAst::none) written.insert(ast.string(ops[5]).str());
+				break;
+			case NodeKind::MethodCall: {
+				auto found = localFunctions.find(ast.string(ops[0]).str());
+				if (found == localFunctions.end()) break;
+				for (auto fn : found->second) {
+					if (seen.insert(fn).second) pending.push_back(fn);
+				}
+				break;
+			}
+			case NodeKind::ArrayAssignment:
+				/* Stores through the data pointer, which a copied array header shares */
+				break;
+			case NodeKind::ExternDeclaration:
+				i = ast.starts[i];
+				break;
+			default:
+				break;
+			}
+		}
+	}
+}
+
+void hashNode(const FlatAst& ast, uint32_t node, MD5& hash)
+{
+	auto start = ast.starts[node];
+	auto word = [&](uint64_t value) {
+		uint8_t bytes[8];
+		std::memcpy(bytes, &value, sizeof bytes);
+		hash.update(makeArrayRef(bytes));
+	};
+	for (auto i = start; i <= node; ++i) {
+		auto ops = ast.operandsOf(i);
+		word(static_cast<uint8_t>(ast.tags[i]));
+		word(ops.size());
+		for (uint32_t k = 0; k < ops.size(); ++k) {
+			/* Children by their position in the subtree, strings by content: the indices depend on the rest of the file */
+			if (ops[k] == FlatAst::none) {
+				word(FlatAst::none);
+				continue;
+			}
+			switch (FlatAst::operandKind(ast.tags[i], k)) {
+			case FlatAst::Child:
+				word(ops[k] - start);
+				break;
+			case FlatAst::String:
+				word(ast.string(ops[k]).size());
+				hash.update(ast.string(ops[k]));
+				break;
+			case FlatAst::Literal:
+				word(ast.literals[ops[k]]);
+				break;
+			case FlatAst::Value:
+				word(ops[k]);
+				break;
+			}
+		}
+	}
+}
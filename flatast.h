@@ -0,0 +1,84 @@
+#pragma once
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MD5.h>
+
+class Node;
+class NBlock;
+enum class NodeKind : uint8_t;
+
+/* The AST as flat arrays: the kind of every node, its operands as 32-bit indices into the node array or the
+   literal and string tables. Children come before their parents, so the subtree of node i is the
+   range [starts[i], i] and analyses walk it linearly instead of chasing pointers. */
+class FlatAst
+{
+public:
+	enum OperandKind : uint8_t
+	{
+		Child,
+		String,
+		Literal,
+		Value
+	};
+
+	static const uint32_t none = ~0u;
+
+	std::vector<NodeKind> tags;
+	std::vector<uint32_t> first{0};           /* operands of node i are operands[first[i]..first[i + 1]) */
+	std::vector<uint32_t> operands;
+	std::vector<uint64_t> literals;           /* integers, and doubles by their bits */
+	std::vector<uint32_t> offsets{0};         /* string i is chars[offsets[i]..offsets[i + 1]) */
+	std::string chars;
+	std::vector<uint32_t> starts;
+	std::vector<Node*> nodes;                 /* the tree node each one was made from or rebuilt as */
+
+	static OperandKind operandKind(NodeKind tag, uint32_t position);
+	static int operatorToken(uint32_t op);
+
+	uint32_t size() const { return static_cast<uint32_t>(tags.size()); }
+	uint32_t strings() const { return static_cast<uint32_t>(offsets.size() - 1); }
+	bool contains(const Node* node) const { return indices.count(node) != 0; }
+
+	llvm::ArrayRef<uint32_t> operandsOf(uint32_t node) const
+	{
+		return llvm::makeArrayRef(operands.data() + first[node], operands.data() + first[node + 1]);
+	}
+
+	llvm::StringRef string(uint32_t id) const
+	{
+		return llvm::StringRef(chars.data() + offsets[id], offsets[id + 1] - offsets[id]);
+	}
+
+	void clear();
+	/* Index of a tree node, flattening its subtree first if it is not in here yet */
+	uint32_t indexOf(Node* node);
+	/* Checks arrays filled from outside and builds the tree from them, false if they don't make an AST */
+	NBlock* rebuild();
+	/* A fresh copy of the subtree of node with the names in renames replaced */
+	Node* clone(uint32_t node, const std::map<std::string, std::string>& renames);
+
+private:
+	llvm::DenseMap<const Node*, uint32_t> indices;
+	std::map<std::string, uint32_t> stringIds;
+	const std::map<std::string, std::string>* renames = nullptr;
+
+	uint32_t flatten(Node* node);
+	uint32_t intern(const std::string& s);
+	uint32_t literal(uint64_t value);
+	uint32_t emit(NodeKind tag, uint32_t start, Node* node, std::vector<uint32_t> const& ops);
+	Node* build(uint32_t node, bool& ok);
+};
+
+/* Collects the variables and functions referenced under node, and the names it defines itself */
+void collectNames(const FlatAst& ast, uint32_t node, std::set<std::string>& vars, std::set<std::string>& calls, std::set<std::string>& defined);
+
+/* Collects the variables assigned under node, or under any local function it may call */
+void collectWrites(const FlatAst& ast, uint32_t node, std::set<std::string>& written);
+
+/* Feeds the subtree to hash so that two subtrees hash alike exactly when they are the same code */
+void hashNode(const FlatAst& ast, uint32_t node, llvm::MD5& hash);
@@ -0,0 +1,266 @@
+#include "inliner.h"
+#include "codegen.h"
+#include "node.h"
+#include <algorithm>
+
+namespace
+{
+	const uint32_t none = FlatAst::none;
+
+	/* Decides on the flat form which local functions can be inlined, then walks the tree replacing the calls */
+	class Inliner : public NodeVisitor<Inliner, void>
+	{
+		CodeGenContext& context;
+		FlatAst& ast;
+		uint32_t root;
+		/* The innermost function declaration around every node, none for the script itself */
+		std::vector<uint32_t> owners;
+		/* Local functions by where they are declared and their name, none if they can't be inlined */
+		std::map<std::pair<uint32_t, std::string>, uint32_t> functions;
+		/* The parameters and variables of every candidate, they get fresh names in each copy */
+		std::map<uint32_t, std::set<std::string>> locals;
+		int copies = 0;
+
+		bool isOperand(uint32_t parent, uint32_t child) const
+		{
+			auto ops = ast.operandsOf(parent);
+			return std::find(ops.begin(), ops.end(), child) != ops.end();
+		}
+
+		/* True if var names the same variable where function k is declared and where it is called: it is either
+		   declared outside the function around k, or once, directly in its body before k */
+		bool capturedAlike(uint32_t k, const std::string& var) const
+		{
+			auto owner = owners[k];
+			auto body = owner == none ? root : ast.operandsOf(owner)[3];
+			auto definitions = 0;
+			auto direct = false;
+			for (auto i = ast.starts[owner == none ? root : owner]; i < (owner == none ? root : owner); ++i) {
+				if (owners[i] != owner) continue;
+				auto ops = ast.operandsOf(i);
+				StringRef name;
+				switch (ast.tags[i]) {
+				case NodeKind::VariableDefinition:
+				case NodeKind::ArrayDefinition:
+					name = ast.string(ops[1]);
+					break;
+				case NodeKind::ForBlock:
+				case NodeKind::ParallelFor:
+					name = ast.string(ops[0]);
+					break;
+				default:
+					continue;
+				}
+				if (name != var) continue;
+				++definitions;
+				direct = i < k && (isOperand(body, i) || (owner != none && isOperand(owner, i)));
+			}
+			return definitions == 0 || (definitions == 1 && direct);
+		}
+
+		/* Small, without functions of its own, returning only at the end and calling nothing it could shadow */
+		bool inlinable(uint32_t k)
+		{
+			auto ops = ast.operandsOf(k);
+			auto body = ops[3];
+			if (body - ast.starts[body] + 1 > context.inlineThreshold) return false;
+			auto statements = ast.operandsOf(body);
+			if (statements.empty()) return false;
+			auto last = statements.back();
+			if (ast.tags[last] != NodeKind::ExpressionStatement && ast.tags[last] != NodeKind::ReturnStatement) return false;
+			auto type = ast.string(ops[1]);
+			if (type != "int" && type != "double" && type != "bool" && !type.endswith("[]")) return false;
+
+			auto& names = locals[k];
+			for (size_t i = 4; i < ops.size(); ++i) {
+				if (!names.insert(ast.string(ast.operandsOf(ops[i])[1]).str()).second) return false;
+			}
+			for (auto i = ast.starts[body]; i <= body; ++i) {
+				auto node = ast.operandsOf(i);
+				switch (ast.tags[i]) {
+				case NodeKind::FunctionDeclaration:
+				case NodeKind::ExternDeclaration:
+					return false;
+				case NodeKind::ReturnStatement:
+					if (i != last) return false;
+					break;
+				case NodeKind::MethodCall:
+					if (node[0] == ops[2]) return false;
+					break;
+				case NodeKind::VariableDefinition:
+				case NodeKind::ArrayDefinition:
+					/* One flat renaming has to do for the whole body, so nothing in it may shadow */
+					if (!names.insert(ast.string(node[1]).str()).second) return false;
+					break;
+				case NodeKind::ForBlock:
+				case NodeKind::ParallelFor:
+					if (!names.insert(ast.string(node[0]).str()).second) return false;
+					break;
+				default:
+					break;
+				}
+			}
+
+			std::set<std::string> vars, calls, defined;
+			collectNames(ast, body, vars, calls, defined);
+			for (auto const& call : calls) {
+				if (names.count(call)) return false;
+			}
+			for (auto const& var : vars) {
+				if (!names.count(var) && !capturedAlike(k, var)) return false;
+			}
+			return true;
+		}
+
+		/* { let p:T = arg ... body ... let result:R = last; result } with everything of its own renamed, parameters
+		   the body assigns are vars */
+		NExpression* expand(uint32_t k, ExpressionList& arguments)
+		{
+			auto ops = ast.operandsOf(k);
+			auto prefix = ast.string(ops[2]).str() + "." + std::to_string(++copies) + ".";
+			std::map<std::string, std::string> renames;
+			for (auto const& name : locals[k]) {
+				renames[name] = prefix + name;
+			}
+			std::set<std::string> written;
+			collectWrites(ast, ops[3], written);
+			auto block = new NBlock();
+			for (size_t i = 4; i < ops.size(); ++i) {
+				auto param = ast.operandsOf(ops[i]);
+				auto name = ast.string(param[1]).str();
+				auto& id = *new NIdentifier(renames[name]);
+				block->statements.push_back(new NVariableDefinition(*new NIdentifier(ast.string(param[0]).str()), id, arguments[i - 4], !written.count(name)));
+			}
+			auto statements = ast.operandsOf(ops[3]);
+			for (size_t i = 0; i + 1 < statements.size(); ++i) {
+				block->statements.push_back(cast<NStatement>(ast.clone(statements[i], renames)));
+			}
+			/* The value goes through a variable of the return type, as it would have through the return */
+			auto value = cast<NExpression>(ast.clone(ast.operandsOf(statements.back())[0], renames));
+			auto& result = *new NIdentifier(prefix + "result");
+			block->statements.push_back(new NVariableDefinition(*new NIdentifier(ast.string(ops[1]).str()), result, value, true));
+			block->statements.push_back(new NExpressionStatement(*new NIdentifier(result.name)));
+			return block;
+		}
+
+		void replace(NExpression*& slot)
+		{
+			visit(*slot);
+			auto call = dyn_cast<NMethodCall>(slot);
+			if (!call || !ast.contains(call)) return;
+			auto index = ast.indexOf(call);
+			auto found = functions.find(std::make_pair(owners[index], call->id.name));
+			/* Calls before the declaration don't reach it */
+			if (found == functions.end() || found->second == none || found->second > index) return;
+			if (call->arguments.size() + 4 != ast.operandsOf(found->second).size()) return;
+			context.dclog << debug_stream::info << "Inlining call to " << call->id.name << std::endl;
+			slot = expand(found->second, call->arguments);
+			++inlined;
+		}
+
+	public:
+		int inlined = 0;
+
+		Inliner(NBlock& block, CodeGenContext& context) : context(context), ast(context.ast)
+		{
+			root = ast.indexOf(&block);
+			owners.assign(ast.size(), none);
+			for (auto k = int64_t(ast.size()) - 1; k >= 0; --k) {
+				if (ast.tags[k] != NodeKind::FunctionDeclaration) continue;
+				for (auto i = ast.starts[k]; i < k; ++i) owners[i] = static_cast<uint32_t>(k);
+			}
+			for (uint32_t k = 0; k < ast.size(); ++k) {
+				auto ops = ast.operandsOf(k);
+				if (ast.tags[k] != NodeKind::FunctionDeclaration || !ops[0]) continue;
+				/* Of two with one name in one place the first is called, leave both alone */
+				auto added = functions.emplace(std::make_pair(owners[k], ast.string(ops[2]).str()), k);
+				if (!added.second || !inlinable(k)) added.first->second = none;
+			}
+		}
+
+		void visitMethodCall(NMethodCall& node)
+		{
+			for (auto& arg : node.arguments) replace(arg);
+		}
+
+		void visitBinaryOperator(NBinaryOperator& node)
+		{
+			replace(node.lhs);
+			replace(node.rhs);
+		}
+
+		void visitAssignment(NAssignment& node) { replace(node.rhs); }
+		void visitArrayIndex(NArrayIndex& node) { replace(node.index); }
+
+		void visitArrayAssignment(NArrayAssignment& node)
+		{
+			replace(node.index);
+			replace(node.rhs);
+		}
+
+		void visitBlock(NBlock& node)
+		{
+			for (auto statement : node.statements) visit(*statement);
+		}
+
+		void visitExpressionStatement(NExpressionStatement& node) { replace(node.expression); }
+		void visitReturnStatement(NReturnStatement& node) { replace(node.expression); }
+
+		void visitIfBlock(NIfBlock& node)
+		{
+			replace(node.cond);
+			replace(node.thenblock);
+			replace(node.elseblock);
+		}
+
+		void visitWhileBlock(NWhileBlock& node)
+		{
+			replace(node.cond);
+			visit(node.doblock);
+		}
+
+		void visitForBlock(NForBlock& node)
+		{
+			replace(node.from);
+			replace(node.to);
+			if (node.step) replace(node.step);
+			visit(node.doblock);
+		}
+
+		void visitParallelFor(NParallelFor& node)
+		{
+			replace(node.from);
+			replace(node.to);
+			visit(node.doblock);
+		}
+
+		void visitVariableDefinition(NVariableDefinition& node)
+		{
+			if (node.assignmentExpr) replace(node.assignmentExpr);
+		}
+
+		void visitArrayDefinition(NArrayDefinition& node)
+		{
+			replace(node.size);
+			if (node.assignmentExpr) replace(node.assignmentExpr);
+		}
+
+		void visitFunctionDeclaration(NFunctionDeclaration& node) { visit(node.block); }
+		void visitCast(NCast& node) { replace(node.expression); }
+
+		void visitMatch(NMatch& node)
+		{
+			replace(node.subject);
+			for (auto& arm : node.cases) replace(arm.second);
+			replace(node.otherwise);
+		}
+	};
+}
+
+int inlineCalls(NBlock& root, CodeGenContext& context)
+{
+	if (!context.inlineThreshold) return 0;
+	Inliner inliner(root, context);
+	inliner.visit(root);
+	return inliner.inlined;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+class NBlock;
+class CodeGenContext;
+
+/* Replaces calls to small local functions under root by a block holding their body, up to
+   CodeGenContext::inlineThreshold nodes. Returns how many calls it replaced. */
+int inlineCalls(NBlock& root, CodeGenContext& context);
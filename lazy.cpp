@@ -0,0 +1,134 @@
+#include "codegen.h"
+#include "node.h"
+#include "runtime.h"
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/IndirectionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LazyReexports.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+
+namespace
+{
+	/* Owns the AST of one top-level function and generates its module when the JIT first looks it up */
+	class DeferredFunctionUnit : public orc::MaterializationUnit
+	{
+		CodeGenContext& context;
+		orc::IRLayer& layer;
+		DeferredFunction function;
+		DataLayout dataLayout;
+
+		void discard(const orc::JITDylib&, const orc::SymbolStringPtr&) override { }
+
+	public:
+		DeferredFunctionUnit(CodeGenContext& context, orc::IRLayer& layer, DeferredFunction function, orc::SymbolStringPtr symbol, DataLayout dataLayout) :
+			MaterializationUnit(Interface(orc::SymbolFlagsMap{{symbol, JITSymbolFlags::Exported | JITSymbolFlags::Callable}}, nullptr)),
+			context(context), layer(layer), function(std::move(function)), dataLayout(std::move(dataLayout)) { }
+
+		StringRef getName() const override
+		{
+			return "DeferredFunctionUnit";
+		}
+
+		void materialize(std::unique_ptr<orc::MaterializationResponsibility> responsibility) override
+		{
+			auto unit = context.generateDeferred(function);
+			unit->setDataLayout(dataLayout);
+			layer.emit(std::move(responsibility), orc::ThreadSafeModule(std::unique_ptr<Module>(unit), context.threadSafeContext));
+		}
+	};
+
+	void lazyCallFailed()
+	{
+		std::cerr << "Can't compile a function on its first call" << std::endl;
+		exit(1);
+	}
+}
+
+/* Lazy execution: the deferred functions sit behind stubs, calling one the first time generates its module
+   and compiles it, the functions that are never called never become IR */
+int64_t CodeGenContext::runLazy()
+{
+	auto builder = orc::JITTargetMachineBuilder::detectHost();
+	if (!builder) {
+		logAllUnhandledErrors(builder.takeError(), errs(), "Error: ");
+		exit(1);
+	}
+	builder->setCodeGenOptLevel(CodeGenOpt::Aggressive);
+	auto tm = builder->createTargetMachine();
+	if (!tm) {
+		logAllUnhandledErrors(tm.takeError(), errs(), "Error: ");
+		exit(1);
+	}
+	auto jit = orc::LLJITBuilder().setJITTargetMachineBuilder(*builder).create();
+	if (!jit) {
+		logAllUnhandledErrors(jit.takeError(), errs(), "Error: ");
+		exit(1);
+	}
+	if (optimize) {
+		(*jit)->getIRTransformLayer().setTransform([&](orc::ThreadSafeModule unit, orc::MaterializationResponsibility&) {
+			unit.withModuleDo([&](Module& m) { optimizeModule(**tm, m); });
+			return Expected<orc::ThreadSafeModule>(std::move(unit));
+		});
+	}
+	auto& dylib = (*jit)->getMainJITDylib();
+	auto process = orc::DynamicLibrarySearchGenerator::GetForCurrentProcess((*jit)->getDataLayout().getGlobalPrefix());
+	if (!process) {
+		logAllUnhandledErrors(process.takeError(), errs(), "Error: ");
+		exit(1);
+	}
+	dylib.addGenerator(std::move(*process));
+	orc::SymbolMap runtime;
+	for (auto const& symbol : runtimeSymbols()) {
+		runtime[(*jit)->mangleAndIntern(symbol.first)] = JITEvaluatedSymbol(pointerToJITTargetAddress(symbol.second), JITSymbolFlags::Exported);
+	}
+	if (auto err = dylib.define(orc::absoluteSymbols(runtime))) {
+		logAllUnhandledErrors(std::move(err), errs(), "Error: ");
+		exit(1);
+	}
+
+	/* The definitions live in a dylib of their own and resolve what they call through the stubs as well,
+	   so generating a function doesn't pull in the ones it calls */
+	auto definitions = (*jit)->createJITDylib("deferred");
+	if (!definitions) {
+		logAllUnhandledErrors(definitions.takeError(), errs(), "Error: ");
+		exit(1);
+	}
+	definitions->setLinkOrder({{&dylib, orc::JITDylibLookupFlags::MatchAllSymbols}}, false);
+	auto& session = (*jit)->getExecutionSession();
+	auto callThrough = orc::createLocalLazyCallThroughManager((*jit)->getTargetTriple(), session, pointerToJITTargetAddress(&lazyCallFailed));
+	if (!callThrough) {
+		logAllUnhandledErrors(callThrough.takeError(), errs(), "Error: ");
+		exit(1);
+	}
+	auto stubs = orc::createLocalIndirectStubsManagerBuilder((*jit)->getTargetTriple())();
+	orc::SymbolAliasMap aliases;
+	for (auto const& function : deferredFunctions) {
+		auto symbol = (*jit)->mangleAndIntern(persistentFunctions[function.declaration->id.name].symbol);
+		aliases[symbol] = orc::SymbolAliasMapEntry(symbol, JITSymbolFlags::Exported | JITSymbolFlags::Callable);
+		auto unit = std::make_unique<DeferredFunctionUnit>(*this, (*jit)->getIRTransformLayer(), function, symbol, (*jit)->getDataLayout());
+		if (auto err = definitions->define(std::move(unit))) {
+			logAllUnhandledErrors(std::move(err), errs(), "Error: ");
+			exit(1);
+		}
+	}
+	if (auto err = dylib.define(orc::lazyReexports(**callThrough, *stubs, *definitions, std::move(aliases)))) {
+		logAllUnhandledErrors(std::move(err), errs(), "Error: ");
+		exit(1);
+	}
+
+	dclog << debug_stream::info << "Running code lazily..." << std::endl;
+	module->setDataLayout((*jit)->getDataLayout());
+	auto entry = mainFunction->getName().str();
+	if (auto err = (*jit)->addIRModule(orc::ThreadSafeModule(std::unique_ptr<Module>(module), threadSafeContext))) {
+		logAllUnhandledErrors(std::move(err), errs(), "Error: ");
+		exit(1);
+	}
+	auto main = (*jit)->lookup(entry);
+	if (!main) {
+		logAllUnhandledErrors(main.takeError(), errs(), "Error: ");
+		exit(1);
+	}
+	auto result = reinterpret_cast<int64_t (*)()>(main->getAddress())();
+	toy_flush_output();
+	dclog << debug_stream::info << "Code was run." << std::endl;
+	return result;
+}
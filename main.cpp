@@ -1,20 +1,97 @@
 #include "codegen.h"
 #include "node.h"
+#include "astcache.h"
+#include "bytecode.h"
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
 #include <llvm/Support/TargetSelect.h>
-
-extern int yyparse();
-extern NBlock* programBlock;
+#include <iterator>
 
 void createCoreFunctions(CodeGenContext& context);
+int runRepl(CodeGenContext& context);
+int runDaemon(CodeGenContext& context, const std::string& path);
+
+/* Only code generation needs the target, the interpreter starts without it */
+static void initializeNativeTarget()
+{
+	InitializeNativeTarget();
+	InitializeNativeTargetAsmPrinter();
+	InitializeNativeTargetAsmParser();
+}
 
 int main(int argc, char *argv[])
 {
 	auto compileOnly = false;
+	auto optimize = false;
+	auto repl = false;
+	auto tiered = false;
+	auto lazy = false;
+	auto interpreted = false;
+	std::string daemon;
+	std::string cacheDirectory;
+	/* Looked up next to the executable unless given */
+	SmallString<128> builtins(sys::path::parent_path(sys::fs::getMainExecutable(argv[0], reinterpret_cast<void*>(&main))));
+	sys::path::append(builtins, "builtins.bc");
 	auto logLevel = 4;
+	auto inlineThreshold = 24;
+	auto selectThreshold = 8;
 	for(auto i = 0; i < argc; ++i) {
 		if(std::string(argv[i]).compare("-c") == 0 || std::string(argv[i]).compare("--compile") == 0) {
 			compileOnly = true;
 		}
+		if(std::string(argv[i]).compare("-O") == 0 || std::string(argv[i]).compare("--optimize") == 0) {
+			optimize = true;
+		}
+		if(std::string(argv[i]).compare("-i") == 0 || std::string(argv[i]).compare("--repl") == 0) {
+			repl = true;
+		}
+		if(std::string(argv[i]).compare("--tiered") == 0) {
+			tiered = true;
+		}
+		if(std::string(argv[i]).compare("--lazy") == 0) {
+			lazy = true;
+		}
+		if(std::string(argv[i]).compare("--interpret") == 0) {
+			interpreted = true;
+		}
+		if(std::string(argv[i]).compare("--daemon") == 0) {
+			if(i + 1 >= argc) {
+				std::cerr << "--daemon needs a socket path" << std::endl;
+				exit(2);
+			}
+			daemon = argv[++i];
+		}
+		if(std::string(argv[i]).compare("--builtins") == 0) {
+			if(i + 1 >= argc) {
+				std::cerr << "--builtins needs a bitcode file" << std::endl;
+				exit(2);
+			}
+			builtins = argv[++i];
+		}
+		if(std::string(argv[i]).compare("--cache") == 0) {
+			if(i + 1 >= argc) {
+				std::cerr << "--cache needs a directory" << std::endl;
+				exit(2);
+			}
+			cacheDirectory = argv[++i];
+		}
+		if(std::string(argv[i]).compare("--inline") == 0) {
+			if(i + 1 >= argc || atoi(argv[i + 1]) < 0) {
+				std::cerr << "--inline needs a node count, 0 turns it off" << std::endl;
+				exit(2);
+			}
+			inlineThreshold = atoi(argv[++i]);
+		}
+		if(std::string(argv[i]).compare("--select") == 0) {
+			if(i + 1 >= argc || atoi(argv[i + 1]) < 0) {
+				std::cerr << "--select needs a node count, 0 turns it off" << std::endl;
+				exit(2);
+			}
+			selectThreshold = atoi(argv[++i]);
+		}
 		if(std::string(argv[i]).find("--log") == 0) {
 			if(argv[i][5] < '0' || argv[i][5] > '4') {
 				std::cerr << "Bad level" << std::endl;
@@ -23,15 +100,80 @@ int main(int argc, char *argv[])
 			logLevel = argv[i][5] - '0';
 		}
 	}
-	yyparse();
-	InitializeNativeTarget();
-	InitializeNativeTargetAsmPrinter();
-	InitializeNativeTargetAsmParser();
 	CodeGenContext context;
 	context.dclog.max_level = debug_stream::level(logLevel);
+	context.optimize = optimize;
+	context.inlineThreshold = inlineThreshold;
+	context.selectThreshold = selectThreshold;
+	context.osrEntries = tiered;
+	context.loadBuiltins(builtins.str().str());
+	if (repl) {
+		initializeNativeTarget();
+		return runRepl(context);
+	}
 	createCoreFunctions(context);
+	if (!daemon.empty()) {
+		initializeNativeTarget();
+		return runDaemon(context, daemon);
+	}
+	std::unique_ptr<ObjectFileCache> cache;
+	if (!cacheDirectory.empty()) {
+		if (auto ec = sys::fs::create_directories(cacheDirectory)) {
+			std::cerr << "Can't create " << cacheDirectory << ": " << ec.message() << std::endl;
+			exit(2);
+		}
+		ObjectFileCache::prune(cacheDirectory);
+	}
+	/* Objects of another build of the compiler may call into a different runtime, so they are keyed by it */
+	if (!cacheDirectory.empty() && !tiered && !lazy) {
+		auto executable = MemoryBuffer::getFile(sys::fs::getMainExecutable(argv[0], reinterpret_cast<void*>(&main)));
+		if (executable) {
+			MD5 hash;
+			hash.update((*executable)->getBuffer());
+			MD5::MD5Result digest;
+			hash.final(digest);
+			context.buildId = digest.digest().str().str();
+		} else {
+			context.dclog << debug_stream::warn << "Objects are not cached, can't read the executable: " << executable.getError().message() << std::endl;
+		}
+	}
+	/* Tiered code is compiled in one module and lazy code in the JIT, only the AST cache applies */
+	if (!context.buildId.empty()) {
+		cache.reset(new ObjectFileCache(cacheDirectory));
+		context.objectCache = cache.get();
+		context.separateFunctions = true;
+	}
+	/* Tiering needs every function up front */
+	if (lazy && !tiered) {
+		context.separateFunctions = true;
+		context.lazyFunctions = true;
+	}
+	std::string source((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+	auto programBlock = parseSource(source, cacheDirectory, context.ast);
+	int64_t result;
+	if (interpreted && !compileOnly && interpret(*programBlock, context, result)) {
+		(context.llclog << result << "\n").flush();
+		return 0;
+	}
+	initializeNativeTarget();
 	context.generateCode(*programBlock);
-	if (!compileOnly) {
+	if (cache) {
+		/* Top-level functions are keyed already, the rest of the script is keyed by its IR */
+		std::string ir;
+		raw_string_ostream out(ir);
+		out << context.buildId << " " << context.builtinsHash << " " << optimize << " " << sys::getHostCPUName() << "\n";
+		context.module->print(out, nullptr);
+		MD5 hash;
+		hash.update(out.str());
+		MD5::MD5Result digest;
+		hash.final(digest);
+		context.module->setModuleIdentifier("main." + digest.digest().str().str());
+	}
+	if (!compileOnly && tiered) {
+		(context.llclog << context.runTiered() << "\n").flush();
+	} else if (!compileOnly && context.lazyFunctions) {
+		(context.llclog << context.runLazy() << "\n").flush();
+	} else if (!compileOnly) {
 		auto val = context.runCode();
 		(context.llclog << val.IntVal.getSExtValue() << "\n").flush();
 	}
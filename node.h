@@ -1,6 +1,9 @@
 #pragma once
+#include <map>
+#include <string>
 #include <vector>
 #include <llvm/IR/Value.h>
+#include <llvm/Support/ErrorHandling.h>
 
 class CodeGenContext;
 class NStatement;
@@ -13,60 +16,112 @@ typedef std::vector<NVariableDefinition*> VariableList;
 
 using namespace llvm;
 
+/* What a node is, for switches and isa/cast/dyn_cast. The AST cache stores these, so only append */
+enum class NodeKind : uint8_t
+{
+	Bool,
+	Integer,
+	Double,
+	Identifier,
+	MethodCall,
+	BinaryOperator,
+	Assignment,
+	ArrayIndex,
+	ArrayAssignment,
+	ArrayLength,
+	Block,
+	ExpressionStatement,
+	ReturnStatement,
+	IfBlock,
+	WhileBlock,
+	ForBlock,
+	ParallelFor,
+	VariableDefinition,
+	ArrayDefinition,
+	ExternDeclaration,
+	FunctionDeclaration,
+	VariableDeclaration, /* only lives inside the parser */
+	Cast,
+	Match
+};
+
+const char* nodeKindName(NodeKind kind);
+
 class Node
 {
 public:
+	const NodeKind kind;
+	explicit Node(NodeKind kind) : kind(kind) { }
 	virtual ~Node() {}
-	virtual Value* codeGen(CodeGenContext& context) { return nullptr; }
+	/* Switches over kind to the codeGen of the node class, which are not virtual */
+	Value* codeGen(CodeGenContext& context);
 };
 
 class NExpression : public Node
-{};
+{
+protected:
+	explicit NExpression(NodeKind kind) : Node(kind) { }
+public:
+	/* The static type, set by assignTypes before code is generated */
+	Type* type = nullptr;
+
+	static bool classof(const Node* node)
+	{
+		return node->kind <= NodeKind::Block || node->kind == NodeKind::IfBlock || node->kind == NodeKind::Cast || node->kind == NodeKind::Match;
+	}
+};
 
 class NStatement : public Node
-{};
+{
+protected:
+	explicit NStatement(NodeKind kind) : Node(kind) { }
+public:
+	static bool classof(const Node* node) { return !NExpression::classof(node); }
+};
 
 class NValue : public NExpression
 {
 protected:
-	NValue() {}
+	explicit NValue(NodeKind kind) : NExpression(kind) { }
 public:
-	Value* codeGen(CodeGenContext& context) override = 0;
-	virtual int64_t getValue() = 0;
+	static bool classof(const Node* node) { return node->kind == NodeKind::Bool || node->kind == NodeKind::Integer; }
+	int64_t getValue();
 };
 
 class NBool : public NValue
 {
 public:
 	bool value;
-	explicit NBool(bool value) : value(value) { }
-	Value* codeGen(CodeGenContext& context) override;
-	int64_t getValue() override;
+	explicit NBool(bool value) : NValue(NodeKind::Bool), value(value) { }
+	static bool classof(const Node* node) { return node->kind == NodeKind::Bool; }
+	Value* codeGen(CodeGenContext& context);
 };
 
 class NInteger : public NValue
 {
 public:
 	int64_t value;
-	explicit NInteger(int64_t value) : value(value) { }
-	Value* codeGen(CodeGenContext& context) override;
-	int64_t getValue() override;
+	explicit NInteger(int64_t value) : NValue(NodeKind::Integer), value(value) { }
+	static bool classof(const Node* node) { return node->kind == NodeKind::Integer; }
+	Value* codeGen(CodeGenContext& context);
 };
 
 class NDouble : public NExpression
 {
 public:
 	double value;
-	explicit NDouble(double value) : value(value) { }
-	Value* codeGen(CodeGenContext& context) override;
+	explicit NDouble(double value) : NExpression(NodeKind::Double), value(value) { }
+	static bool classof(const Node* node) { return node->kind == NodeKind::Double; }
+	Value* codeGen(CodeGenContext& context);
 };
 
 class NIdentifier : public NExpression
 {
 public:
 	std::string name;
-	explicit NIdentifier(const std::string& name) : name(name) { }
-	Value* codeGen(CodeGenContext& context) override;
+	explicit NIdentifier(const std::string& name) : NExpression(NodeKind::Identifier), name(name) { }
+	static bool classof(const Node* node) { return node->kind == NodeKind::Identifier; }
+	Value* codeGen(CodeGenContext& context);
 };
 
 class NMethodCall : public NExpression
@@ -76,88 +131,197 @@ public:
 	ExpressionList arguments;
 
 	NMethodCall(const NIdentifier& id, ExpressionList& arguments) :
-		id(id), arguments(arguments) { }
+		NExpression(NodeKind::MethodCall), id(id), arguments(arguments) { }
 
-	explicit NMethodCall(const NIdentifier& id) : id(id) { }
-	Value* codeGen(CodeGenContext& context) override;
+	explicit NMethodCall(const NIdentifier& id) : NExpression(NodeKind::MethodCall), id(id) { }
+	static bool classof(const Node* node) { return node->kind == NodeKind::MethodCall; }
+	Value* codeGen(CodeGenContext& context);
 };
 
 class NBinaryOperator : public NExpression
 {
 public:
 	int op;
-	NExpression& lhs;
-	NExpression& rhs;
+	NExpression* lhs;
+	NExpression* rhs;
 
 	NBinaryOperator(NExpression& lhs, int op, NExpression& rhs) :
-		op(op), lhs(lhs), rhs(rhs) { }
+		NExpression(NodeKind::BinaryOperator), op(op), lhs(&lhs), rhs(&rhs) { }
 
-	Value* codeGen(CodeGenContext& context) override;
+	static bool classof(const Node* node) { return node->kind == NodeKind::BinaryOperator; }
+	Value* codeGen(CodeGenContext& context);
 };
 
 class NAssignment : public NExpression
 {
 public:
 	NIdentifier& lhs;
-	NExpression& rhs;
+	NExpression* rhs;
 
 	NAssignment(NIdentifier& lhs, NExpression& rhs) :
-		lhs(lhs), rhs(rhs) { }
+		NExpression(NodeKind::Assignment), lhs(lhs), rhs(&rhs) { }
+
+	static bool classof(const Node* node) { return node->kind == NodeKind::Assignment; }
+	Value* codeGen(CodeGenContext& context);
+};
+
+class NArrayIndex : public NExpression
+{
+public:
+	NIdentifier& id;
+	NExpression* index;
+
+	NArrayIndex(NIdentifier& id, NExpression& index) :
+		NExpression(NodeKind::ArrayIndex), id(id), index(&index) { }
 
-	Value* codeGen(CodeGenContext& context) override;
+	static bool classof(const Node* node) { return node->kind == NodeKind::ArrayIndex; }
+	Value* codeGen(CodeGenContext& context);
+};
+
+class NArrayAssignment : public NExpression
+{
+public:
+	NIdentifier& id;
+	NExpression* index;
+	NExpression* rhs;
+
+	NArrayAssignment(NIdentifier& id, NExpression& index, NExpression& rhs) :
+		NExpression(NodeKind::ArrayAssignment), id(id), index(&index), rhs(&rhs) { }
+
+	static bool classof(const Node* node) { return node->kind == NodeKind::ArrayAssignment; }
+	Value* codeGen(CodeGenContext& context);
+};
+
+class NArrayLength : public NExpression
+{
+public:
+	NIdentifier& id;
+
+	explicit NArrayLength(NIdentifier& id) : NExpression(NodeKind::ArrayLength), id(id) { }
+
+	static bool classof(const Node* node) { return node->kind == NodeKind::ArrayLength; }
+	Value* codeGen(CodeGenContext& context);
 };
 
 class NBlock : public NExpression
 {
 public:
 	StatementList statements;
-	NBlock() { }
-	Value* codeGen(CodeGenContext& context) override;
+	NBlock() : NExpression(NodeKind::Block) { }
+	static bool classof(const Node* node) { return node->kind == NodeKind::Block; }
+	Value* codeGen(CodeGenContext& context);
 };
 
 class NExpressionStatement : public NStatement
 {
 public:
-	NExpression& expression;
+	NExpression* expression;
 
 	explicit NExpressionStatement(NExpression& expression) :
-		expression(expression) { }
+		NStatement(NodeKind::ExpressionStatement), expression(&expression) { }
 
-	Value* codeGen(CodeGenContext& context) override;
+	static bool classof(const Node* node) { return node->kind == NodeKind::ExpressionStatement; }
+	Value* codeGen(CodeGenContext& context);
 };
 
 class NReturnStatement : public NStatement
 {
 public:
-	NExpression& expression;
+	NExpression* expression;
 
 	NReturnStatement(NExpression& expression) :
-		expression(expression) { }
+		NStatement(NodeKind::ReturnStatement), expression(&expression) { }
 
-	Value* codeGen(CodeGenContext& context) override;
+	static bool classof(const Node* node) { return node->kind == NodeKind::ReturnStatement; }
+	Value* codeGen(CodeGenContext& context);
 };
 
 class NIfBlock : public NExpression
 {
 public:
-	NExpression& cond;
-	NExpression& thenblock;
-	NExpression& elseblock;
+	NExpression* cond;
+	NExpression* thenblock;
+	NExpression* elseblock;
 
 	NIfBlock(NExpression& cond, NExpression& thenblock, NExpression& elseblock) :
-		cond(cond), thenblock(thenblock), elseblock(elseblock) { };
-	Value* codeGen(CodeGenContext& context) override;
+		NExpression(NodeKind::IfBlock), cond(&cond), thenblock(&thenblock), elseblock(&elseblock) { };
+	static bool classof(const Node* node) { return node->kind == NodeKind::IfBlock; }
+	Value* codeGen(CodeGenContext& context);
+};
+
+/* A conversion the code used to make on the fly, made explicit by assignTypes */
+class NCast : public NExpression
+{
+public:
+	const NIdentifier& target;
+	NExpression* expression;
+
+	NCast(const NIdentifier& target, NExpression& expression) :
+		NExpression(NodeKind::Cast), target(target), expression(&expression) { }
+
+	static bool classof(const Node* node) { return node->kind == NodeKind::Cast; }
+	Value* codeGen(CodeGenContext& context);
+};
+
+/* The value of the arm whose label equals the integer subject, otherwise the value of the _ arm */
+class NMatch : public NExpression
+{
+public:
+	NExpression* subject = nullptr;
+	std::vector<std::pair<int64_t, NExpression*>> cases;
+	NExpression* otherwise = nullptr;
+
+	NMatch() : NExpression(NodeKind::Match) { }
+
+	static bool classof(const Node* node) { return node->kind == NodeKind::Match; }
+	Value* codeGen(CodeGenContext& context);
 };
 
 class NWhileBlock : public NStatement
 {
 public:
-	NExpression& cond;
+	NExpression* cond;
 	NBlock& doblock;
 
 	NWhileBlock(NExpression& cond, NBlock& doblock) :
-		cond(cond), doblock(doblock) { };
-	Value* codeGen(CodeGenContext& context) override;
+		NStatement(NodeKind::WhileBlock), cond(&cond), doblock(doblock) { };
+	static bool classof(const Node* node) { return node->kind == NodeKind::WhileBlock; }
+	Value* codeGen(CodeGenContext& context);
+};
+
+class NForBlock : public NStatement
+{
+public:
+	NIdentifier& id;
+	NExpression* from;
+	NExpression* to;
+	NExpression* step;
+	NBlock& doblock;
+	std::map<std::string, int64_t> pragmas;
+
+	NForBlock(NIdentifier& id, NExpression& from, NExpression& to, NExpression* step, NBlock& doblock) :
+		NStatement(NodeKind::ForBlock), id(id), from(&from), to(&to), step(step), doblock(doblock) { };
+	static bool classof(const Node* node) { return node->kind == NodeKind::ForBlock; }
+	Value* codeGen(CodeGenContext& context);
+};
+
+class NParallelFor : public NStatement
+{
+public:
+	NIdentifier& id;
+	NExpression* from;
+	NExpression* to;
+	NBlock& doblock;
+	std::string reduceOp;
+	NIdentifier* reduction;
+
+	NParallelFor(NIdentifier& id, NExpression& from, NExpression& to, NBlock& doblock) :
+		NStatement(NodeKind::ParallelFor), id(id), from(&from), to(&to), doblock(doblock), reduction(nullptr) { };
+
+	NParallelFor(NIdentifier& id, NExpression& from, NExpression& to, const std::string& reduceOp, NIdentifier* reduction, NBlock& doblock) :
+		NStatement(NodeKind::ParallelFor), id(id), from(&from), to(&to), doblock(doblock), reduceOp(reduceOp), reduction(reduction) { };
+	static bool classof(const Node* node) { return node->kind == NodeKind::ParallelFor; }
+	Value* codeGen(CodeGenContext& context);
 };
 
 class NVariableDefinition : public NStatement
@@ -166,14 +330,35 @@ public:
 	const NIdentifier& type;
 	NIdentifier& id;
 	NExpression* assignmentExpr;
+	/* A let binding, which is never assigned after its definition */
+	bool immutable = false;
 
 	NVariableDefinition(const NIdentifier& type, NIdentifier& id) :
-		type(type), id(id) { assignmentExpr = nullptr; }
+		NStatement(NodeKind::VariableDefinition), type(type), id(id) { assignmentExpr = nullptr; }
 
-	NVariableDefinition(const NIdentifier& type, NIdentifier& id, NExpression* assignmentExpr) :
-		type(type), id(id), assignmentExpr(assignmentExpr) { }
+	NVariableDefinition(const NIdentifier& type, NIdentifier& id, NExpression* assignmentExpr, bool immutable = false) :
+		NStatement(NodeKind::VariableDefinition), type(type), id(id), assignmentExpr(assignmentExpr), immutable(immutable) { }
 
-	Value* codeGen(CodeGenContext& context) override;
+	static bool classof(const Node* node) { return node->kind == NodeKind::VariableDefinition; }
+	Value* codeGen(CodeGenContext& context);
+};
+
+class NArrayDefinition : public NStatement
+{
+public:
+	const NIdentifier& type;
+	NIdentifier& id;
+	NExpression* size;
+	NExpression* assignmentExpr;
+
+	NArrayDefinition(const NIdentifier& type, NIdentifier& id, NExpression& size) :
+		NStatement(NodeKind::ArrayDefinition), type(type), id(id), size(&size) { assignmentExpr = nullptr; }
+
+	NArrayDefinition(const NIdentifier& type, NIdentifier& id, NExpression& size, NExpression* assignmentExpr) :
+		NStatement(NodeKind::ArrayDefinition), type(type), id(id), size(&size), assignmentExpr(assignmentExpr) { }
+
+	static bool classof(const Node* node) { return node->kind == NodeKind::ArrayDefinition; }
+	Value* codeGen(CodeGenContext& context);
 };
 
 class NVariableDeclaration : public NStatement
@@ -183,7 +368,9 @@ public:
 	NIdentifier& id;
 
 	NVariableDeclaration(const NIdentifier& type, NIdentifier& id) :
-		type(type), id(id) { }
+		NStatement(NodeKind::VariableDeclaration), type(type), id(id) { }
+
+	static bool classof(const Node* node) { return node->kind == NodeKind::VariableDeclaration; }
 };
 
 class NExternDeclaration : public NStatement
@@ -195,9 +382,10 @@ public:
 
 	NExternDeclaration(const NIdentifier& type, const NIdentifier& id,
 	                   const VariableList& arguments) :
-		type(type), id(id), arguments(arguments) {}
+		NStatement(NodeKind::ExternDeclaration), type(type), id(id), arguments(arguments) {}
 
-	Value* codeGen(CodeGenContext& context) override;
+	static bool classof(const Node* node) { return node->kind == NodeKind::ExternDeclaration; }
+	Value* codeGen(CodeGenContext& context);
 };
 
 class NFunctionDeclaration : public NStatement
@@ -211,7 +399,78 @@ public:
 
 	NFunctionDeclaration(const NIdentifier& type, const NIdentifier& id,
 	                     const VariableList& arguments, NBlock& block, bool local) :
-		local(local), type(type), id(id), arguments(arguments), block(block) { }
+		NStatement(NodeKind::FunctionDeclaration), local(local), type(type), id(id), arguments(arguments), block(block) { }
 
-	Value* codeGen(CodeGenContext& context) override;
+	static bool classof(const Node* node) { return node->kind == NodeKind::FunctionDeclaration; }
+	Value* codeGen(CodeGenContext& context);
+};
+
+/* A pass derives from NodeVisitor<Pass, Result> and defines visitBool, visitBlock, ... for the kinds it
+   cares about. visit switches over the kind, so there is no virtual call and the compiler can inline the
+   handlers. The kinds a pass leaves out go to visitNode with their own class, which a pass can define as
+   a template to treat them all alike. */
+template <typename Derived, typename Result = void>
+class NodeVisitor
+{
+	Derived& derived() { return *static_cast<Derived*>(this); }
+
+public:
+	Result visit(Node& node)
+	{
+		switch (node.kind) {
+		case NodeKind::Bool: return derived().visitBool(static_cast<NBool&>(node));
+		case NodeKind::Integer: return derived().visitInteger(static_cast<NInteger&>(node));
+		case NodeKind::Double: return derived().visitDouble(static_cast<NDouble&>(node));
+		case NodeKind::Identifier: return derived().visitIdentifier(static_cast<NIdentifier&>(node));
+		case NodeKind::MethodCall: return derived().visitMethodCall(static_cast<NMethodCall&>(node));
+		case NodeKind::BinaryOperator: return derived().visitBinaryOperator(static_cast<NBinaryOperator&>(node));
+		case NodeKind::Assignment: return derived().visitAssignment(static_cast<NAssignment&>(node));
+		case NodeKind::ArrayIndex: return derived().visitArrayIndex(static_cast<NArrayIndex&>(node));
+		case NodeKind::ArrayAssignment: return derived().visitArrayAssignment(static_cast<NArrayAssignment&>(node));
+		case NodeKind::ArrayLength: return derived().visitArrayLength(static_cast<NArrayLength&>(node));
+		case NodeKind::Block: return derived().visitBlock(static_cast<NBlock&>(node));
+		case NodeKind::ExpressionStatement: return derived().visitExpressionStatement(static_cast<NExpressionStatement&>(node));
+		case NodeKind::ReturnStatement: return derived().visitReturnStatement(static_cast<NReturnStatement&>(node));
+		case NodeKind::IfBlock: return derived().visitIfBlock(static_cast<NIfBlock&>(node));
+		case NodeKind::WhileBlock: return derived().visitWhileBlock(static_cast<NWhileBlock&>(node));
+		case NodeKind::ForBlock: return derived().visitForBlock(static_cast<NForBlock&>(node));
+		case NodeKind::ParallelFor: return derived().visitParallelFor(static_cast<NParallelFor&>(node));
+		case NodeKind::VariableDefinition: return derived().visitVariableDefinition(static_cast<NVariableDefinition&>(node));
+		case NodeKind::ArrayDefinition: return derived().visitArrayDefinition(static_cast<NArrayDefinition&>(node));
+		case NodeKind::ExternDeclaration: return derived().visitExternDeclaration(static_cast<NExternDeclaration&>(node));
+		case NodeKind::FunctionDeclaration: return derived().visitFunctionDeclaration(static_cast<NFunctionDeclaration&>(node));
+		case NodeKind::VariableDeclaration: return derived().visitVariableDeclaration(static_cast<NVariableDeclaration&>(node));
+		case NodeKind::Cast: return derived().visitCast(static_cast<NCast&>(node));
+		case NodeKind::Match: return derived().visitMatch(static_cast<NMatch&>(node));
+		}
+		llvm_unreachable("Unknown node kind");
+	}
+
+	Result visitBool(NBool& node) { return derived().visitNode(node); }
+	Result visitInteger(NInteger& node) { return derived().visitNode(node); }
+	Result visitDouble(NDouble& node) { return derived().visitNode(node); }
+	Result visitIdentifier(NIdentifier& node) { return derived().visitNode(node); }
+	Result visitMethodCall(NMethodCall& node) { return derived().visitNode(node); }
+	Result visitBinaryOperator(NBinaryOperator& node) { return derived().visitNode(node); }
+	Result visitAssignment(NAssignment& node) { return derived().visitNode(node); }
+	Result visitArrayIndex(NArrayIndex& node) { return derived().visitNode(node); }
+	Result visitArrayAssignment(NArrayAssignment& node) { return derived().visitNode(node); }
+	Result visitArrayLength(NArrayLength& node) { return derived().visitNode(node); }
+	Result visitBlock(NBlock& node) { return derived().visitNode(node); }
+	Result visitExpressionStatement(NExpressionStatement& node) { return derived().visitNode(node); }
+	Result visitReturnStatement(NReturnStatement& node) { return derived().visitNode(node); }
+	Result visitIfBlock(NIfBlock& node) { return derived().visitNode(node); }
+	Result visitWhileBlock(NWhileBlock& node) { return derived().visitNode(node); }
+	Result visitForBlock(NForBlock& node) { return derived().visitNode(node); }
+	Result visitParallelFor(NParallelFor& node) { return derived().visitNode(node); }
+	Result visitVariableDefinition(NVariableDefinition& node) { return derived().visitNode(node); }
+	Result visitArrayDefinition(NArrayDefinition& node) { return derived().visitNode(node); }
+	Result visitExternDeclaration(NExternDeclaration& node) { return derived().visitNode(node); }
+	Result visitFunctionDeclaration(NFunctionDeclaration& node) { return derived().visitNode(node); }
+	Result visitVariableDeclaration(NVariableDeclaration& node) { return derived().visitNode(node); }
+	Result visitCast(NCast& node) { return derived().visitNode(node); }
+	Result visitMatch(NMatch& node) { return derived().visitNode(node); }
+
+	template <typename T>
+	Result visitNode(T&) { return Result(); }
 };
@@ -6,8 +6,26 @@
 	NBlock *programBlock; /* the top level root node of our final AST */
 
 	extern int yylex();
-	void yyerror(const char *s) { std::printf("Error: %s\n", s);std::exit(1); }
+	bool exitOnParseError = true; /* the REPL keeps going after a bad line */
+	void yyerror(const char *s) { std::printf("Error: %s\n", s); if (exitOnParseError) std::exit(1); }
 	extern bool term[2];
+
+	/* Labels must be distinct, and only the one arm may be the _ that catches the rest */
+	bool addArm(NMatch *match, std::string *label, NExpression *value)
+	{
+		if (*label == "_") {
+			if (match->otherwise) { yyerror("match has more than one _ arm"); return false; }
+			match->otherwise = value;
+		} else {
+			auto number = atol(label->c_str());
+			for (auto const& arm : match->cases) {
+				if (arm.first == number) { yyerror("duplicate match label"); return false; }
+			}
+			match->cases.push_back(std::make_pair(number, value));
+		}
+		delete label;
+		return true;
+	}
 %}
 
 /* Represents the many different ways we can access our data */
@@ -19,8 +37,10 @@
 	NIdentifier *ident;
 	NVariableDeclaration *decl;
 	NVariableDefinition *var_def;
+	NMatch *match;
 	std::vector<NVariableDefinition*> *varvec;
 	std::vector<NExpression*> *exprvec;
+	std::map<std::string, int64_t> *pragmas;
 	std::string *string;
 	std::string *keyword;
 	int token;
@@ -31,10 +51,10 @@
    they represent.
  */
 %token <string> TIDENTIFIER TINTEGER TDOUBLE
-%token <keyword> KIF KTHEN KELSE KRETURN KEXTERN KBFALSE KBTRUE KWHILE KVAR KFN KLKFN
-%token <token> TCEQ TCNE TCLT TCLE TCGT TCGE TEQUAL TCL TNOT
-%token <token> TLPAREN TRPAREN TLBRACE TRBRACE TCOMMA TDOT
-%token <token> TPLUS TMINUS TMUL TDIV TPOW
+%token <keyword> KIF KTHEN KELSE KRETURN KEXTERN KBFALSE KBTRUE KWHILE KVAR KFN KLKFN KLEN KPARALLEL KFOR KIN KREDUCE KSTEP KMATCH KLET
+%token <token> TCEQ TCNE TCLT TCLE TCGT TCGE TEQUAL TCL TNOT TAT TARROW
+%token <token> TLPAREN TRPAREN TLBRACE TRBRACE TLBRACKET TRBRACKET TCOMMA TDOT TRANGE
+%token <token> TPLUS TMINUS TMUL TDIV TPOW TAND TOR
 
 
 /* Define the type of node our nonterminal symbols represent.
@@ -43,15 +63,23 @@
    calling an (NIdentifier*). It makes the compiler happy.
  */
 %type <ident> ident
-%type <expr> numeric expr boolean if_block
+%type <expr> numeric expr boolean if_block match_block
+%type <match> match_arms
 %type <varvec> func_decl_args
 %type <decl> decl
 %type <exprvec> call_args
 %type <block> program stmts block
-%type <stmt> stmt var_def func_decl extern_decl while_block
+%type <stmt> stmt var_def func_decl extern_decl while_block parallel_block for_block
+%type <pragmas> pragmas
+%type <string> reduce_op match_label
 %type <token> comparison
 
-/* Operator precedence for mathematical operators */
+/* Operator precedence, loosest first: the logical operators, ! (which still covers a comparison after it),
+   the comparisons and the mathematical operators */
+%left TOR
+%left TAND
+%right TNOT
+%left TCEQ TCNE TCLT TCLE TCGT TCGE
 %left TPLUS TMINUS
 %left TMUL TDIV
 %left TPOW
@@ -71,20 +99,50 @@ stmt : var_def | func_decl | extern_decl
 	 | expr { $$ = new NExpressionStatement(*$1); }
 	 | KRETURN expr { $$ = new NReturnStatement(*$2); }
 	 | while_block
+	 | parallel_block
+	 | for_block
+	 | pragmas for_block { static_cast<NForBlock*>($2)->pragmas = *$1; delete $1; $$ = $2; }
      ;
 	
 while_block : KWHILE expr block
 			{ $$ = new NWhileBlock(*$2, *$3); }
 			;
 
+for_block : KFOR ident KIN expr TRANGE expr block
+		  { $$ = new NForBlock(*$2, *$4, *$6, nullptr, *$7); }
+		  | KFOR ident KIN expr TRANGE expr KSTEP expr block
+		  { $$ = new NForBlock(*$2, *$4, *$6, $8, *$9); }
+		  ;
+
+pragmas : TAT ident { $$ = new std::map<std::string, int64_t>(); (*$$)[$2->name] = 0; delete $2; }
+		| TAT ident TLPAREN TINTEGER TRPAREN { $$ = new std::map<std::string, int64_t>(); (*$$)[$2->name] = atol($4->c_str()); delete $2; delete $4; }
+		| pragmas TAT ident { (*$1)[$3->name] = 0; delete $3; }
+		| pragmas TAT ident TLPAREN TINTEGER TRPAREN { (*$1)[$3->name] = atol($5->c_str()); delete $3; delete $5; }
+		;
+
+parallel_block : KPARALLEL KFOR ident KIN expr TRANGE expr block
+			   { $$ = new NParallelFor(*$3, *$5, *$7, *$8); }
+			   | KPARALLEL KFOR ident KIN expr TRANGE expr KREDUCE TLPAREN reduce_op TCL ident TRPAREN block
+			   { $$ = new NParallelFor(*$3, *$5, *$7, *$10, $12, *$14); delete $10; }
+			   ;
+
+reduce_op : TPLUS { $$ = new std::string("+"); }
+		  | TMUL { $$ = new std::string("*"); }
+		  | TIDENTIFIER
+		  ;
+
 block : TLBRACE stmts TRBRACE { $$ = $2; }
 	  | TLBRACE TRBRACE { $$ = new NBlock(); }
 	  ;
 
 decl : ident TCL ident  { $$ = new NVariableDeclaration(*$3, *$1); }
+	 | ident TCL ident TLBRACKET TRBRACKET { $$ = new NVariableDeclaration(*new NIdentifier($3->name + "[]"), *$1); delete $3; }
 	 ;
 var_def : KVAR decl { $$ = new NVariableDefinition($2->type, $2->id); delete $2;}
 		 | KVAR decl TEQUAL expr { $$ = new NVariableDefinition($2->type, $2->id ,$4); delete $2;}
+		 | KLET decl TEQUAL expr { $$ = new NVariableDefinition($2->type, $2->id, $4, true); delete $2;}
+		 | KVAR ident TCL ident TLBRACKET expr TRBRACKET { $$ = new NArrayDefinition(*$4, *$2, *$6); }
+		 | KVAR ident TCL ident TLBRACKET expr TRBRACKET TEQUAL expr { $$ = new NArrayDefinition(*$4, *$2, *$6, $9); }
 		 ;
 
 extern_decl : KEXTERN ident ident TLPAREN func_decl_args TRPAREN
@@ -107,6 +165,19 @@ if_block : KIF expr KTHEN expr KELSE expr
 		   { $$ = new NIfBlock(*$2,*$3,*$5); }
 		 ;
 
+match_block : KMATCH expr TLBRACE match_arms TRBRACE
+			{ if (!$4->otherwise) { yyerror("match needs a _ arm"); YYERROR; } $4->subject = $2; $$ = $4; }
+			;
+
+match_arms : match_label TARROW expr { $$ = new NMatch(); if (!addArm($$, $1, $3)) YYERROR; }
+		   | match_arms TCOMMA match_label TARROW expr { if (!addArm($1, $3, $5)) YYERROR; }
+		   ;
+
+match_label : TINTEGER
+			| TMINUS TINTEGER { $$ = new std::string("-" + *$2); delete $2; }
+			| TIDENTIFIER { if (*$1 != "_") { yyerror("match labels must be integers or _"); YYERROR; } }
+			;
+
 boolean : KBTRUE { $$ = new NBool(true);  }
 		| KBFALSE { $$ = new NBool(false); }
 		;
@@ -119,7 +190,11 @@ numeric : TINTEGER { $$ = new NInteger(atol($1->c_str())); delete $1; }
 		;
 
 expr : ident TEQUAL expr { $$ = new NAssignment(*$<ident>1, *$3); }
+	 | ident TLBRACKET expr TRBRACKET TEQUAL expr { $$ = new NArrayAssignment(*$1, *$3, *$6); }
+	 | ident TLBRACKET expr TRBRACKET { $$ = new NArrayIndex(*$1, *$3); }
+	 | KLEN TLPAREN ident TRPAREN { $$ = new NArrayLength(*$3); }
 	 | if_block { $$ = $1; }
+	 | match_block
 	 | ident TLPAREN call_args TRPAREN { $$ = new NMethodCall(*$1, *$3); delete $3; }
 	 | ident { $<ident>$ = $1; }
 	 | boolean
@@ -129,7 +204,9 @@ expr : ident TEQUAL expr { $$ = new NAssignment(*$<ident>1, *$3); }
          | expr TDIV expr { $$ = new NBinaryOperator(*$1, $2, *$3); }
          | expr TPLUS expr { $$ = new NBinaryOperator(*$1, $2, *$3); }
          | expr TMINUS expr { $$ = new NBinaryOperator(*$1, $2, *$3); }
- 	 | expr comparison expr { $$ = new NBinaryOperator(*$1, $2, *$3); }
+ 	 | expr comparison expr %prec TCEQ { $$ = new NBinaryOperator(*$1, $2, *$3); }
+ 	 | expr TAND expr { $$ = new NBinaryOperator(*$1, $2, *$3); }
+ 	 | expr TOR expr { $$ = new NBinaryOperator(*$1, $2, *$3); }
  	 | TNOT expr { $$ = new NBinaryOperator(*$2, $1, *new NBool(true)); }
      | TLPAREN expr TRPAREN { $$ = $2; }
 	 | block { $$ = $1; }
@@ -0,0 +1,121 @@
+#include "codegen.h"
+#include "node.h"
+#include "runtime.h"
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/Support/Process.h>
+
+extern int yyparse();
+extern NBlock* programBlock;
+extern bool exitOnParseError;
+
+typedef struct yy_buffer_state* YY_BUFFER_STATE;
+extern YY_BUFFER_STATE yy_scan_string(const char* str);
+extern void yy_delete_buffer(YY_BUFFER_STATE buffer);
+
+void createCoreFunctions(CodeGenContext& context);
+
+/* An input is complete once every bracket it opens is closed, so blocks can span lines */
+static bool isComplete(const std::string& input)
+{
+	auto depth = 0;
+	for (auto c : input) {
+		if (c == '(' || c == '{' || c == '[') ++depth;
+		if (c == ')' || c == '}' || c == ']') --depth;
+	}
+	return depth <= 0;
+}
+
+/* Read-eval-print loop: every complete input is compiled into a module of its own and added to a
+   single LLJIT, so the functions and variables defined earlier stay linked and are never recompiled.
+   The value of a top-level expression is echoed. An input with an error is reported and dropped. */
+int runRepl(CodeGenContext& context)
+{
+	auto jit = orc::LLJITBuilder().create();
+	if (!jit) {
+		logAllUnhandledErrors(jit.takeError(), errs(), "Error: ");
+		return 1;
+	}
+	auto& dylib = (*jit)->getMainJITDylib();
+	auto process = orc::DynamicLibrarySearchGenerator::GetForCurrentProcess((*jit)->getDataLayout().getGlobalPrefix());
+	if (!process) {
+		logAllUnhandledErrors(process.takeError(), errs(), "Error: ");
+		return 1;
+	}
+	dylib.addGenerator(std::move(*process));
+	orc::SymbolMap runtime;
+	for (auto const& symbol : runtimeSymbols()) {
+		runtime[(*jit)->mangleAndIntern(symbol.first)] = JITEvaluatedSymbol(pointerToJITTargetAddress(symbol.second), JITSymbolFlags::Exported);
+	}
+	if (auto err = dylib.define(orc::absoluteSymbols(runtime))) {
+		logAllUnhandledErrors(std::move(err), errs(), "Error: ");
+		return 1;
+	}
+
+	context.incremental = true;
+	context.echoResults = true;
+	context.dumpModule = context.dclog.max_level >= debug_stream::verbose;
+	exitOnParseError = false;
+	auto interactive = sys::Process::StandardInIsUserInput();
+	std::string input, line;
+	auto chunk = 0;
+	while (true) {
+		if (interactive) {
+			std::clog << (input.empty() ? "> " : ". ") << std::flush;
+		}
+		if (!std::getline(std::cin, line)) {
+			break;
+		}
+		input += line + "\n";
+		if (!isComplete(input)) {
+			continue;
+		}
+		if (input.find_first_not_of(" \t\r\n;") == std::string::npos) {
+			input.clear();
+			continue;
+		}
+
+		programBlock = nullptr;
+		auto buffer = yy_scan_string(input.c_str());
+		auto failed = yyparse();
+		yy_delete_buffer(buffer);
+		input.clear();
+		if (failed || programBlock == nullptr) {
+			continue;
+		}
+
+		auto entry = "__repl_" + std::to_string(chunk++);
+		context.newModule(entry);
+		context.module->setDataLayout((*jit)->getDataLayout());
+		createCoreFunctions(context);
+		/* An input with an error leaves nothing behind: its module goes, and so do the top-level names it declared */
+		auto functions = context.persistentFunctions;
+		auto globals = context.persistentGlobals;
+		auto externs = context.externs;
+		auto extra = context.extra;
+		try {
+			context.generateCode(*programBlock, entry);
+		} catch (CompileError const&) {
+			context.discardModule();
+			context.persistentFunctions = functions;
+			context.persistentGlobals = globals;
+			context.externs = externs;
+			context.extra = extra;
+			continue;
+		}
+		if (auto err = (*jit)->addIRModule(orc::ThreadSafeModule(std::unique_ptr<Module>(context.module), context.threadSafeContext))) {
+			logAllUnhandledErrors(std::move(err), errs(), "Error: ");
+			continue;
+		}
+		auto symbol = (*jit)->lookup(entry);
+		if (!symbol) {
+			logAllUnhandledErrors(symbol.takeError(), errs(), "Error: ");
+			continue;
+		}
+		/* A failed array check ends the input, what it defined stays */
+		int64_t result;
+		toy_run_recoverable(reinterpret_cast<int64_t (*)()>(symbol->getAddress()), result);
+		toy_flush_output();
+	}
+	return 0;
+}
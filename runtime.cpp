@@ -0,0 +1,382 @@
+#include "runtime.h"
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/DynamicLibrary.h>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace llvm;
+
+namespace
+{
+	/* Echoed values pile up here and reach stdout's buffer in one fwrite, so no lock is taken per value */
+	class OutputBuffer
+	{
+		char data[1 << 16];
+		size_t used = 0;
+
+	public:
+		/* Longest line one value can take: a fixed notation double with 6 decimals */
+		static const size_t maxLine = 512;
+
+		~OutputBuffer() { flush(); }
+
+		char* reserve()
+		{
+			if (used + maxLine > sizeof data) flush();
+			return data + used;
+		}
+
+		void commit(char* end) { used = end - data; }
+
+		void flush()
+		{
+			if (used == 0) return;
+			std::fwrite(data, 1, used, stdout);
+			used = 0;
+		}
+	};
+
+	OutputBuffer& outputBuffer()
+	{
+		static thread_local OutputBuffer buffer;
+		return buffer;
+	}
+
+	/* Set by toy_run_recoverable on the thread it runs on. Parallel loops have frames of the pool and other
+	   threads' tasks in flight, so nothing jumps out of them */
+	thread_local std::jmp_buf* recovery = nullptr;
+	thread_local int parallelDepth = 0;
+
+	/* Ends the run after a failed check was reported */
+	[[noreturn]] void abortRun()
+	{
+		if (recovery && parallelDepth == 0) std::longjmp(*recovery, 1);
+		std::exit(1);
+	}
+
+	/* Writes the decimal digits two at a time from the back */
+	char* formatInteger(char* out, int64_t value)
+	{
+		static const char pairs[] =
+			"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+			"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+			"8081828384858687888990919293949596979899";
+		auto magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+		char digits[20];
+		auto p = digits + sizeof digits;
+		while (magnitude >= 100) {
+			auto pair = magnitude % 100 * 2;
+			magnitude /= 100;
+			*--p = pairs[pair + 1];
+			*--p = pairs[pair];
+		}
+		if (magnitude >= 10) {
+			*--p = pairs[magnitude * 2 + 1];
+			*--p = pairs[magnitude * 2];
+		} else {
+			*--p = static_cast<char>('0' + magnitude);
+		}
+		if (value < 0) *out++ = '-';
+		auto count = digits + sizeof digits - p;
+		std::memcpy(out, p, count);
+		return out + count;
+	}
+
+	struct Job
+	{
+		std::function<void(int64_t lo, int64_t hi, size_t slot)> run;
+		std::atomic<size_t> remaining{0};
+	};
+
+	struct Task
+	{
+		Job* job;
+		int64_t lo;
+		int64_t hi;
+		size_t slot;
+	};
+
+	/* Every thread owns a deque: it pops its own tasks from the back and steals from the front of the others.
+	   queues[0] is shared by the threads outside the pool, which run tasks while they wait for their job. */
+	class WorkStealingPool
+	{
+		struct Queue
+		{
+			std::mutex lock;
+			std::deque<Task> tasks;
+		};
+
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> threads;
+		std::mutex sleepLock;
+		std::condition_variable wakeUp;
+		std::atomic<size_t> pending{0};
+		bool stopping = false;
+
+		static thread_local size_t self;
+
+		bool take(Task& task)
+		{
+			for (size_t i = 0; i < queues.size(); ++i) {
+				auto& queue = *queues[(self + i) % queues.size()];
+				std::lock_guard<std::mutex> guard(queue.lock);
+				if (queue.tasks.empty()) continue;
+				if (i == 0) {
+					task = queue.tasks.back();
+					queue.tasks.pop_back();
+				} else {
+					task = queue.tasks.front();
+					queue.tasks.pop_front();
+				}
+				--pending;
+				return true;
+			}
+			return false;
+		}
+
+		void work(size_t index)
+		{
+			self = index;
+			for (;;) {
+				if (runOne()) continue;
+				std::unique_lock<std::mutex> guard(sleepLock);
+				wakeUp.wait(guard, [this] { return stopping || pending.load() != 0; });
+				if (stopping) return;
+			}
+		}
+
+	public:
+		WorkStealingPool()
+		{
+			auto workers = std::max(1u, std::thread::hardware_concurrency()) - 1;
+			for (size_t i = 0; i <= workers; ++i) {
+				queues.emplace_back(new Queue());
+			}
+			for (size_t i = 1; i <= workers; ++i) {
+				threads.emplace_back([this, i] { work(i); });
+			}
+		}
+
+		~WorkStealingPool()
+		{
+			{
+				std::lock_guard<std::mutex> guard(sleepLock);
+				stopping = true;
+			}
+			wakeUp.notify_all();
+			for (auto& t : threads) t.join();
+		}
+
+		size_t size() const { return queues.size(); }
+
+		void submit(std::vector<Task> const& tasks)
+		{
+			pending += tasks.size();
+			for (size_t i = 0; i < tasks.size(); ++i) {
+				auto& queue = *queues[(self + i) % queues.size()];
+				std::lock_guard<std::mutex> guard(queue.lock);
+				queue.tasks.push_back(tasks[i]);
+			}
+			{
+				std::lock_guard<std::mutex> guard(sleepLock);
+			}
+			wakeUp.notify_all();
+		}
+
+		bool runOne()
+		{
+			Task task;
+			if (!take(task)) return false;
+			task.job->run(task.lo, task.hi, task.slot);
+			if (--task.job->remaining == 0) {
+				/* Its waiter may be asleep */
+				{
+					std::lock_guard<std::mutex> guard(sleepLock);
+				}
+				wakeUp.notify_all();
+			}
+			return true;
+		}
+
+		/* Helps with whatever tasks are queued until the job is done, and sleeps while there are none */
+		void wait(Job const& job)
+		{
+			while (job.remaining.load() != 0) {
+				if (runOne()) continue;
+				std::unique_lock<std::mutex> guard(sleepLock);
+				wakeUp.wait(guard, [this, &job] { return job.remaining.load() == 0 || pending.load() != 0; });
+			}
+		}
+	};
+
+	thread_local size_t WorkStealingPool::self = 0;
+
+	WorkStealingPool& workerPool()
+	{
+		static WorkStealingPool pool;
+		return pool;
+	}
+
+	template <typename T>
+	T combine(int32_t op, T a, T b)
+	{
+		switch (op) {
+		case REDUCE_ADD: return a + b;
+		case REDUCE_MUL: return a * b;
+		case REDUCE_MIN: return b < a ? b : a;
+		case REDUCE_MAX: return a < b ? b : a;
+		default: return a;
+		}
+	}
+
+	template <typename T, typename Body>
+	T parallelFor(int64_t lo, int64_t hi, Body body, void* env, int32_t op, T identity)
+	{
+		if (hi <= lo) return identity;
+		auto& pool = workerPool();
+		auto count = hi - lo;
+		auto chunks = std::min<int64_t>(count, pool.size() * 4);
+		std::vector<T> partials(chunks, identity);
+
+		/* What ran before the loop is echoed first. Each chunk's lines stay together unless they overflow its
+		   thread's buffer, but chunks run concurrently, so the order of their output is unspecified */
+		outputBuffer().flush();
+		++parallelDepth;
+		Job job;
+		job.run = [&](int64_t from, int64_t to, size_t slot) {
+			partials[slot] = body(from, to, env);
+			outputBuffer().flush();
+		};
+		job.remaining = chunks;
+		std::vector<Task> tasks;
+		for (int64_t c = 0; c < chunks; ++c) {
+			auto from = lo + count / chunks * c + std::min(c, count % chunks);
+			auto to = lo + count / chunks * (c + 1) + std::min(c + 1, count % chunks);
+			tasks.push_back(Task{&job, from, to, static_cast<size_t>(c)});
+		}
+		pool.submit(tasks);
+		pool.wait(job);
+		--parallelDepth;
+
+		auto result = identity;
+		for (auto partial : partials) {
+			result = combine(op, result, partial);
+		}
+		return result;
+	}
+}
+
+int64_t toy_parallel_for_i64(int64_t lo, int64_t hi, ParallelBodyI64 body, void* env, int32_t op, int64_t identity)
+{
+	return parallelFor(lo, hi, body, env, op, identity);
+}
+
+double toy_parallel_for_f64(int64_t lo, int64_t hi, ParallelBodyF64 body, void* env, int32_t op, double identity)
+{
+	return parallelFor(lo, hi, body, env, op, identity);
+}
+
+void toy_echo_i64(int64_t value)
+{
+	auto& buffer = outputBuffer();
+	auto out = formatInteger(buffer.reserve(), value);
+	*out++ = '\n';
+	buffer.commit(out);
+}
+
+/* Same text as printf("%lf"), formatted by std::to_chars rather than the locale-aware printf machinery */
+void toy_echo_f64(double value)
+{
+	auto& buffer = outputBuffer();
+	auto out = buffer.reserve();
+	out = std::to_chars(out, out + OutputBuffer::maxLine - 1, value, std::chars_format::fixed, 6).ptr;
+	*out++ = '\n';
+	buffer.commit(out);
+}
+
+void toy_echo_bool(int64_t value)
+{
+	auto& buffer = outputBuffer();
+	auto out = buffer.reserve();
+	auto text = value ? "true\n" : "false\n";
+	auto length = std::strlen(text);
+	std::memcpy(out, text, length);
+	buffer.commit(out + length);
+}
+
+void toy_flush_echoes()
+{
+	outputBuffer().flush();
+}
+
+void toy_flush_output()
+{
+	outputBuffer().flush();
+	std::fflush(stdout);
+}
+
+void toy_index_error(int64_t index, int64_t length)
+{
+	toy_flush_output();
+	std::fprintf(stderr, "Index %lld is out of bounds for an array of length %lld\n", static_cast<long long>(index), static_cast<long long>(length));
+	abortRun();
+}
+
+void toy_length_error(int64_t length, int64_t expected)
+{
+	toy_flush_output();
+	std::fprintf(stderr, "Element-wise operand of length %lld where the array assigned to has length %lld\n", static_cast<long long>(length), static_cast<long long>(expected));
+	abortRun();
+}
+
+/* Only JIT code runs between here and the checks, it has nothing to unwind */
+bool toy_run_recoverable(int64_t (*entry)(), int64_t& result)
+{
+	std::jmp_buf here;
+	auto outer = recovery;
+	if (setjmp(here)) {
+		recovery = outer;
+		return false;
+	}
+	recovery = &here;
+	result = entry();
+	recovery = outer;
+	return true;
+}
+
+std::map<std::string, void*> const& runtimeSymbols()
+{
+	static std::map<std::string, void*> symbols = {
+		{"toy_parallel_for_i64", reinterpret_cast<void*>(&toy_parallel_for_i64)},
+		{"toy_parallel_for_f64", reinterpret_cast<void*>(&toy_parallel_for_f64)},
+		{"toy_echo_i64", reinterpret_cast<void*>(&toy_echo_i64)},
+		{"toy_echo_f64", reinterpret_cast<void*>(&toy_echo_f64)},
+		{"toy_echo_bool", reinterpret_cast<void*>(&toy_echo_bool)},
+		{"toy_flush_echoes", reinterpret_cast<void*>(&toy_flush_echoes)},
+		{"toy_flush_output", reinterpret_cast<void*>(&toy_flush_output)},
+		{"toy_index_error", reinterpret_cast<void*>(&toy_index_error)},
+		{"toy_length_error", reinterpret_cast<void*>(&toy_length_error)},
+		{"toy_pow_i64", reinterpret_cast<void*>(&toy_pow_i64)},
+		{"toy_tier_up", reinterpret_cast<void*>(&toy_tier_up)},
+	};
+	return symbols;
+}
+
+void registerRuntimeSymbols()
+{
+	for (auto const& symbol : runtimeSymbols()) {
+		sys::DynamicLibrary::AddSymbol(symbol.first, symbol.second);
+	}
+}
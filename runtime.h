@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+
+/* Functions compiled scripts call into, resolved by the JIT through registerRuntimeSymbols */
+
+enum ReduceOp
+{
+	REDUCE_NONE,
+	REDUCE_ADD,
+	REDUCE_MUL,
+	REDUCE_MIN,
+	REDUCE_MAX
+};
+
+typedef int64_t (*ParallelBodyI64)(int64_t lo, int64_t hi, void* env);
+typedef double (*ParallelBodyF64)(int64_t lo, int64_t hi, void* env);
+
+extern "C" {
+/* Runs body over chunks of [lo, hi) on the worker pool and folds the chunk results with op */
+int64_t toy_parallel_for_i64(int64_t lo, int64_t hi, ParallelBodyI64 body, void* env, int32_t op, int64_t identity);
+double toy_parallel_for_f64(int64_t lo, int64_t hi, ParallelBodyF64 body, void* env, int32_t op, double identity);
+
+/* echo and echod: format into the calling thread's output buffer, which moves to stdout's buffer when it
+   fills, when the thread exits and on toy_flush_echoes. Compiled code calls that before every extern
+   function, so what those print through stdio comes after what the thread echoed before */
+void toy_echo_i64(int64_t value);
+void toy_echo_f64(double value);
+/* Echoes true or false, for the values the REPL shows */
+void toy_echo_bool(int64_t value);
+void toy_flush_echoes();
+/* Flushes the echo buffer and stdout, once a run is done or before an error is reported */
+void toy_flush_output();
+
+/* Array checks that failed: report after the output echoed so far and exit, or end the toy_run_recoverable
+   they happen in when that is on the same thread and outside a parallel loop */
+[[noreturn]] void toy_index_error(int64_t index, int64_t length);
+[[noreturn]] void toy_length_error(int64_t length, int64_t expected);
+
+/* Builtins, also shipped as builtins.bc for inlining */
+int64_t toy_pow_i64(int64_t base, int64_t exponent);
+
+/* Called by baseline code of tiered execution when function id got hot */
+void toy_tier_up(int32_t id);
+}
+
+/* Runs entry, false if an array check failed in it, which the REPL survives */
+bool toy_run_recoverable(int64_t (*entry)(), int64_t& result);
+
+/* Name and address of every function above */
+std::map<std::string, void*> const& runtimeSymbols();
+void registerRuntimeSymbols();
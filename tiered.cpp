@@ -0,0 +1,384 @@
+#include "codegen.h"
+#include "runtime.h"
+#include <llvm/Analysis/CFG.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/CodeExtractor.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace
+{
+	/* Modules whose identifier starts with this hold one hot function and get the full code generator */
+	const std::string tierPrefix = "tier1.";
+
+	class TieredCompiler : public orc::IRCompileLayer::IRCompiler
+	{
+		std::unique_ptr<TargetMachine> baseline;
+		std::unique_ptr<TargetMachine> optimized;
+
+	public:
+		TieredCompiler(std::unique_ptr<TargetMachine> baseline, std::unique_ptr<TargetMachine> optimized) :
+			IRCompiler(orc::irManglingOptionsFromTargetOptions(baseline->Options)), baseline(std::move(baseline)), optimized(std::move(optimized)) { }
+
+		Expected<std::unique_ptr<MemoryBuffer>> operator()(Module& m) override
+		{
+			auto& tm = m.getModuleIdentifier().compare(0, tierPrefix.size(), tierPrefix) == 0 ? *optimized : *baseline;
+			return orc::SimpleCompiler(tm)(m);
+		}
+	};
+
+	/* Takes the requests of functions that got hot and compiles them one by one on a thread of its own */
+	class TierUp
+	{
+		CodeGenContext& context;
+		orc::LLJIT& jit;
+		std::unique_ptr<Module> source;
+		std::unique_ptr<TargetMachine> optimizer;
+		std::vector<std::string> names;
+		std::vector<std::atomic<JITTargetAddress>*> slots;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::deque<int32_t> queue;
+		/* Queued or compiled already: threads that cross the threshold together ask for the same function */
+		std::vector<bool> requested;
+		bool stopping = false;
+		std::thread worker;
+
+		void compile(int32_t id)
+		{
+			auto& name = names[id];
+			std::unique_ptr<Module> m;
+			{
+				/* Everything but the function becomes a declaration, resolved to the baseline module */
+				auto lock = context.threadSafeContext.getLock();
+				m = CloneModule(*source);
+				m->setModuleIdentifier(tierPrefix + name);
+				for (auto& f : *m) {
+					if (f.getName() != name && !f.hasLocalLinkage()) f.deleteBody();
+				}
+				for (auto& g : m->globals()) {
+					g.setInitializer(nullptr);
+					g.setLinkage(GlobalValue::ExternalLinkage);
+				}
+				m->getFunction(name)->setName(name + ".tier1");
+				context.optimizeModule(*optimizer, *m);
+			}
+			if (auto err = jit.addIRModule(orc::ThreadSafeModule(std::move(m), context.threadSafeContext))) {
+				logAllUnhandledErrors(std::move(err), errs(), "Error: ");
+				return;
+			}
+			auto symbol = jit.lookup(name + ".tier1");
+			if (!symbol) {
+				logAllUnhandledErrors(symbol.takeError(), errs(), "Error: ");
+				return;
+			}
+			slots[id]->store(symbol->getAddress());
+			context.dclog << debug_stream::info << "Tiered up " << name << std::endl;
+		}
+
+		void run()
+		{
+			while (true) {
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this] { return stopping || !queue.empty(); });
+				if (stopping) return;
+				auto id = queue.front();
+				queue.pop_front();
+				lock.unlock();
+				compile(id);
+			}
+		}
+
+	public:
+		TierUp(CodeGenContext& context, orc::LLJIT& jit, std::unique_ptr<Module> source, std::unique_ptr<TargetMachine> optimizer) :
+			context(context), jit(jit), source(std::move(source)), optimizer(std::move(optimizer)) { }
+
+		void add(const std::string& name, JITTargetAddress slot)
+		{
+			names.push_back(name);
+			requested.push_back(false);
+			slots.push_back(jitTargetAddressToPointer<std::atomic<JITTargetAddress>*>(slot));
+		}
+
+		void start()
+		{
+			worker = std::thread([this] { run(); });
+		}
+
+		void request(int32_t id)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (requested[id]) return;
+			requested[id] = true;
+			queue.push_back(id);
+			wake.notify_one();
+		}
+
+		/* Waits for the function being compiled, the rest of the queue is dropped */
+		void stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			wake.notify_one();
+			if (worker.joinable()) worker.join();
+		}
+	};
+
+	TierUp* active = nullptr;
+
+	/* Every call of a function goes through a slot holding its address, so a compiled version can be swapped in */
+	std::vector<Function*> addSlots(Module& m, Function* entry)
+	{
+		std::vector<Function*> functions;
+		for (auto& f : m) {
+			if (!f.isDeclaration() && !f.hasLocalLinkage() && &f != entry) functions.push_back(&f);
+		}
+		auto align = m.getDataLayout().getPointerABIAlignment(0);
+		for (auto f : functions) {
+			auto slot = new GlobalVariable(m, f->getType(), false, GlobalValue::ExternalLinkage, f, f->getName() + ".slot");
+			std::vector<Use*> uses;
+			for (auto& use : f->uses()) {
+				if (isa<Instruction>(use.getUser()) && !isa<PHINode>(use.getUser())) uses.push_back(&use);
+			}
+			for (auto use : uses) {
+				auto user = cast<Instruction>(use->getUser());
+				use->set(new LoadInst(f->getType(), slot, f->getName(), false, align, AtomicOrdering::Unordered, SyncScope::System, user));
+			}
+		}
+		return functions;
+	}
+
+	/* The loop's variables come in as pointers to the caller's allocas, if those are only loaded and stored
+	   nothing else reaches them and the compiled copy can keep them in registers */
+	void markPrivateArguments(Function& loop)
+	{
+		auto call = cast<CallInst>(loop.user_back());
+		for (unsigned i = 0; i < call->arg_size(); ++i) {
+			auto alloca = dyn_cast<AllocaInst>(call->getArgOperand(i));
+			if (!alloca) continue;
+			auto isPrivate = std::all_of(alloca->user_begin(), alloca->user_end(), [&](User* user) {
+				if (auto store = dyn_cast<StoreInst>(user)) return store->getPointerOperand() == alloca;
+				return isa<LoadInst>(user) || user == call;
+			});
+			if (isPrivate && std::count(call->arg_begin(), call->arg_end(), alloca) == 1) loop.addParamAttr(i, Attribute::NoAlias);
+		}
+	}
+
+	/* Outermost while loops tagged by codegen move into functions of their own. Their variables are still allocas,
+	   so the loop carries no values but memory and a copy of the function can take over at the header */
+	std::map<Function*, BasicBlock*> extractLoops(Module& m)
+	{
+		std::map<Function*, BasicBlock*> loops;
+		std::vector<Function*> functions;
+		for (auto& f : m) {
+			if (!f.isDeclaration()) functions.push_back(&f);
+		}
+		for (auto f : functions) {
+			bool extracted;
+			do {
+				extracted = false;
+				std::set<BasicBlock*> headers;
+				for (auto& b : *f) {
+					if (b.getTerminator()->getMetadata("toy.osr")) headers.insert(b.getTerminator()->getSuccessor(0));
+				}
+				DominatorTree dt(*f);
+				LoopInfo li(dt);
+				for (auto loop : li) {
+					auto header = loop->getHeader();
+					if (!headers.count(header) || isa<PHINode>(header->front())) continue;
+					CodeExtractor extractor(dt, *loop);
+					if (!extractor.isEligible()) continue;
+					CodeExtractorAnalysisCache cache(*f);
+					auto body = extractor.extractCodeRegion(cache);
+					if (!body) continue;
+					body->setName(f->getName() + ".loop");
+					markPrivateArguments(*body);
+					loops[body] = header;
+					extracted = true;
+					break;
+				}
+			} while (extracted);
+		}
+		return loops;
+	}
+
+	/* Entries and loop back-edges bump a counter, the entry asks for tier-up once it crosses the threshold.
+	   Parallel for workers run the same code, so every access to the counter is atomic; the count only has to
+	   get there, monotonic is enough. */
+	void addCounters(Module& m, std::vector<Function*> const& functions, unsigned threshold)
+	{
+		auto& llvmContext = m.getContext();
+		auto int64 = Type::getInt64Ty(llvmContext);
+		auto one = ConstantInt::get(int64, 1);
+		auto hook = m.getOrInsertFunction("toy_tier_up", Type::getVoidTy(llvmContext), Type::getInt32Ty(llvmContext));
+		for (size_t id = 0; id < functions.size(); ++id) {
+			auto f = functions[id];
+			auto counter = new GlobalVariable(m, int64, false, GlobalValue::ExternalLinkage, ConstantInt::get(int64, 0), f->getName() + ".count");
+			SmallVector<std::pair<const BasicBlock*, const BasicBlock*>, 8> backedges;
+			FindFunctionBackedges(*f, backedges);
+			for (auto const& edge : backedges) {
+				IRBuilder<> at(const_cast<BasicBlock*>(edge.first)->getTerminator());
+				at.CreateAtomicRMW(AtomicRMWInst::Add, counter, one, MaybeAlign(), AtomicOrdering::Monotonic);
+			}
+
+			auto first = f->getEntryBlock().begin();
+			while (isa<AllocaInst>(*first)) ++first;
+			IRBuilder<> at(&*first);
+			auto count = at.CreateAdd(at.CreateAtomicRMW(AtomicRMWInst::Add, counter, one, MaybeAlign(), AtomicOrdering::Monotonic), one);
+			auto hot = at.CreateICmpSGE(count, ConstantInt::get(int64, threshold));
+			IRBuilder<> up(SplitBlockAndInsertIfThen(hot, &*first, false));
+			up.CreateCall(hook, {ConstantInt::get(Type::getInt32Ty(llvmContext), id)});
+			/* Asked once, the calls switch over when it is compiled */
+			up.CreateStore(ConstantInt::get(int64, std::numeric_limits<int64_t>::min()), counter)->setAtomic(AtomicOrdering::Monotonic);
+		}
+	}
+
+	/* A loop asks for tier-up at its header as well, it may never be entered again, and once its slot moves
+	   on it calls the compiled copy with its own arguments, which finishes the loop from the current iteration */
+	void addOsrEntries(Module& m, std::vector<Function*> const& functions, std::map<Function*, BasicBlock*> const& loops, unsigned threshold)
+	{
+		auto& llvmContext = m.getContext();
+		auto int64 = Type::getInt64Ty(llvmContext);
+		auto hook = m.getFunction("toy_tier_up");
+		auto align = m.getDataLayout().getPointerABIAlignment(0);
+		for (size_t id = 0; id < functions.size(); ++id) {
+			auto f = functions[id];
+			auto loop = loops.find(f);
+			if (loop == loops.end()) continue;
+			auto counter = m.getGlobalVariable((f->getName() + ".count").str());
+			auto slot = m.getGlobalVariable((f->getName() + ".slot").str());
+			auto first = loop->second->getFirstNonPHI();
+
+			IRBuilder<> at(first);
+			auto count = at.CreateLoad(int64, counter);
+			count->setAtomic(AtomicOrdering::Monotonic);
+			auto hot = at.CreateICmpSGE(count, ConstantInt::get(int64, threshold));
+			IRBuilder<> up(SplitBlockAndInsertIfThen(hot, first, false));
+			up.CreateCall(hook, {ConstantInt::get(Type::getInt32Ty(llvmContext), id)});
+			up.CreateStore(ConstantInt::get(int64, std::numeric_limits<int64_t>::min()), counter)->setAtomic(AtomicOrdering::Monotonic);
+
+			at.SetInsertPoint(first);
+			auto target = at.Insert(new LoadInst(f->getType(), slot, f->getName(), false, align, AtomicOrdering::Unordered, SyncScope::System));
+			auto moved = at.CreateICmpNE(target, f);
+			IRBuilder<> osr(SplitBlockAndInsertIfThen(moved, first, true));
+			std::vector<Value*> args;
+			for (auto& arg : f->args()) args.push_back(&arg);
+			auto result = osr.CreateCall(f->getFunctionType(), target, args);
+			auto unreachable = osr.GetInsertBlock()->getTerminator();
+			ReturnInst::Create(llvmContext, f->getReturnType()->isVoidTy() ? nullptr : result, unreachable);
+			unreachable->eraseFromParent();
+		}
+	}
+}
+
+extern "C" void toy_tier_up(int32_t id)
+{
+	if (active) active->request(id);
+}
+
+/* Tiered execution: the module is compiled without optimization and starts right away, functions that get
+   hot are optimized and compiled again on a background thread and swapped in through their slots. While
+   loops get functions of their own, so a loop that runs long is swapped in while it runs */
+int64_t CodeGenContext::runTiered()
+{
+	auto baselineBuilder = orc::JITTargetMachineBuilder::detectHost();
+	if (!baselineBuilder) {
+		logAllUnhandledErrors(baselineBuilder.takeError(), errs(), "Error: ");
+		exit(1);
+	}
+	baselineBuilder->setCodeGenOptLevel(CodeGenOpt::None);
+	auto optimizedBuilder = *baselineBuilder;
+	optimizedBuilder.setCodeGenOptLevel(CodeGenOpt::Aggressive);
+	auto jit = orc::LLJITBuilder()
+		.setJITTargetMachineBuilder(*baselineBuilder)
+		.setCompileFunctionCreator([&](orc::JITTargetMachineBuilder builder) -> Expected<std::unique_ptr<orc::IRCompileLayer::IRCompiler>> {
+			auto baseline = builder.createTargetMachine();
+			if (!baseline) return baseline.takeError();
+			auto optimized = optimizedBuilder.createTargetMachine();
+			if (!optimized) return optimized.takeError();
+			return std::make_unique<TieredCompiler>(std::move(*baseline), std::move(*optimized));
+		})
+		.create();
+	if (!jit) {
+		logAllUnhandledErrors(jit.takeError(), errs(), "Error: ");
+		exit(1);
+	}
+	auto optimizer = optimizedBuilder.createTargetMachine();
+	if (!optimizer) {
+		logAllUnhandledErrors(optimizer.takeError(), errs(), "Error: ");
+		exit(1);
+	}
+	auto& dylib = (*jit)->getMainJITDylib();
+	auto process = orc::DynamicLibrarySearchGenerator::GetForCurrentProcess((*jit)->getDataLayout().getGlobalPrefix());
+	if (!process) {
+		logAllUnhandledErrors(process.takeError(), errs(), "Error: ");
+		exit(1);
+	}
+	dylib.addGenerator(std::move(*process));
+	orc::SymbolMap runtime;
+	for (auto const& symbol : runtimeSymbols()) {
+		runtime[(*jit)->mangleAndIntern(symbol.first)] = JITEvaluatedSymbol(pointerToJITTargetAddress(symbol.second), JITSymbolFlags::Exported);
+	}
+	if (auto err = dylib.define(orc::absoluteSymbols(runtime))) {
+		logAllUnhandledErrors(std::move(err), errs(), "Error: ");
+		exit(1);
+	}
+
+	/* Tier-up modules link against everything in here, except the builtins: they stay internal and get copied */
+	module->setDataLayout((*jit)->getDataLayout());
+	auto loops = extractLoops(*module);
+	for (auto& g : module->global_values()) {
+		if (g.isDeclaration() || (builtins && builtins->getNamedValue(g.getName()))) continue;
+		if (!g.hasName()) g.setName("tier.global");
+		g.setLinkage(GlobalValue::ExternalLinkage);
+		g.setVisibility(GlobalValue::DefaultVisibility);
+	}
+	auto functions = addSlots(*module, mainFunction);
+	TierUp tiers(*this, **jit, CloneModule(*module), std::move(*optimizer));
+	addCounters(*module, functions, tierThreshold);
+	addOsrEntries(*module, functions, loops, tierThreshold);
+	std::vector<std::string> names;
+	for (auto f : functions) names.push_back(f->getName().str());
+	auto entry = mainFunction->getName().str();
+
+	dclog << debug_stream::info << "Running code tiered..." << std::endl;
+	if (auto err = (*jit)->addIRModule(orc::ThreadSafeModule(std::unique_ptr<Module>(module), threadSafeContext))) {
+		logAllUnhandledErrors(std::move(err), errs(), "Error: ");
+		exit(1);
+	}
+	auto main = (*jit)->lookup(entry);
+	if (!main) {
+		logAllUnhandledErrors(main.takeError(), errs(), "Error: ");
+		exit(1);
+	}
+	for (auto const& name : names) {
+		auto slot = (*jit)->lookup(name + ".slot");
+		if (!slot) {
+			logAllUnhandledErrors(slot.takeError(), errs(), "Error: ");
+			exit(1);
+		}
+		tiers.add(name, slot->getAddress());
+	}
+	active = &tiers;
+	tiers.start();
+	auto result = reinterpret_cast<int64_t (*)()>(main->getAddress())();
+	toy_flush_output();
+	tiers.stop();
+	active = nullptr;
+	dclog << debug_stream::info << "Code was run." << std::endl;
+	return result;
+}
@@ -0,0 +1,479 @@
+#include "typecheck.h"
+#include "codegen.h"
+#include "node.h"
+#include "parser.hpp"
+
+namespace
+{
+	/* Mirrors the blocks code generation pushes: a function body only sees outside of itself when it is local */
+	struct Scope
+	{
+		std::map<std::string, Type*> variables;
+		std::map<std::string, FunctionType*> functions;
+		/* The variables bound with let */
+		std::set<std::string> immutable;
+		/* The arrays defined with a literal length */
+		std::map<std::string, int64_t> lengths;
+		bool transparent;
+	};
+
+	bool isComparison(int op)
+	{
+		return op == TCEQ || op == TCNE || op == TCLT || op == TCLE || op == TCGT || op == TCGE;
+	}
+
+	bool isElementwise(int op)
+	{
+		return op == TPLUS || op == TMINUS || op == TMUL || op == TDIV;
+	}
+
+	/* The type of every expression, and of the value every statement leaves behind for the block it ends */
+	class TypeChecker : public NodeVisitor<TypeChecker, Type*>
+	{
+		CodeGenContext& context;
+		std::vector<Scope> scopes;
+		std::map<std::string, FunctionType*> functions;
+		/* The return types of the functions being checked, innermost last */
+		std::vector<Type*> results;
+		Type* int64;
+		Type* real;
+		Type* boolean;
+		Type* none;
+
+		bool isArray(Type* type) const
+		{
+			return type && context.arrayElementType(type);
+		}
+
+		std::string typeName(Type* type) const
+		{
+			if (type == int64) return "int";
+			if (type == real) return "double";
+			if (type == boolean) return "bool";
+			if (isArray(type)) return typeName(context.arrayElementType(type)) + "[]";
+			return "void";
+		}
+
+		void push(bool transparent)
+		{
+			scopes.push_back(Scope());
+			scopes.back().transparent = transparent;
+		}
+
+		Type* variable(const std::string& name)
+		{
+			for (auto i = scopes.rbegin(); i != scopes.rend(); ++i) {
+				auto found = i->variables.find(name);
+				if (found != i->variables.end()) return found->second;
+				if (!i->transparent) break;
+			}
+			std::cerr << "undeclared variable " << name << std::endl;
+			context.fail();
+		}
+
+		/* Exits if name is bound with let, which nothing may assign */
+		void assignable(const std::string& name)
+		{
+			for (auto i = scopes.rbegin(); i != scopes.rend(); ++i) {
+				if (!i->variables.count(name)) {
+					if (!i->transparent) break;
+					continue;
+				}
+				if (i->immutable.count(name)) {
+					std::cerr << "can't assign to " << name << ", it is bound with let" << std::endl;
+					context.fail();
+				}
+				return;
+			}
+		}
+
+		/* The length of the array name is bound to, -1 unless its definition says */
+		int64_t knownLength(const std::string& name)
+		{
+			for (auto i = scopes.rbegin(); i != scopes.rend(); ++i) {
+				if (i->variables.count(name)) {
+					auto found = i->lengths.find(name);
+					return found == i->lengths.end() ? -1 : found->second;
+				}
+				if (!i->transparent) break;
+			}
+			return -1;
+		}
+
+		/* Exits if an array named in the element-wise expression is known to differ in length from the destination */
+		void checkLengths(NExpression& expr, int64_t expected)
+		{
+			auto binop = dyn_cast<NBinaryOperator>(&expr);
+			if (binop && isArray(expr.type)) {
+				checkLengths(*binop->lhs, expected);
+				checkLengths(*binop->rhs, expected);
+				return;
+			}
+			auto id = dyn_cast<NIdentifier>(&expr);
+			if (!id || !isArray(id->type) || expected < 0) return;
+			auto length = knownLength(id->name);
+			if (length >= 0 && length != expected) {
+				std::cerr << id->name << " has length " << length << " where the array assigned to has length " << expected << std::endl;
+				context.fail();
+			}
+		}
+
+		Type* array(const std::string& name)
+		{
+			auto type = variable(name);
+			if (!isArray(type)) {
+				std::cerr << name << " is not an array" << std::endl;
+				context.fail();
+			}
+			return type;
+		}
+
+		/* The function returns what its last top-level return gives, or else the value of its last statement,
+		   which has to be an expression of the declared type */
+		void returns(NFunctionDeclaration& node)
+		{
+			auto& statements = node.block.statements;
+			for (auto statement : statements) {
+				if (isa<NReturnStatement>(statement)) return;
+			}
+			auto type = typeOf(node.type, context);
+			auto last = statements.empty() ? nullptr : dyn_cast<NExpressionStatement>(statements.back());
+			if (type == none) return;
+			if (last) {
+				require(last->expression, type);
+			} else {
+				std::cerr << "function " << node.id.name << " must end with a value of type " << typeName(type) << std::endl;
+				context.fail();
+			}
+		}
+
+		/* In the order code generation looks them up: module level first, then the local functions in reach */
+		FunctionType* function(const std::string& name)
+		{
+			auto found = functions.find(name);
+			if (found != functions.end()) return found->second;
+			auto persistent = context.persistentFunctions.find(name);
+			if (persistent != context.persistentFunctions.end()) return static_cast<FunctionType*>(persistent->second.type);
+			if (auto existing = context.findFunction(name)) return existing->getFunctionType();
+			for (auto i = scopes.rbegin(); i != scopes.rend(); ++i) {
+				auto local = i->functions.find(name);
+				if (local != i->functions.end()) return local->second;
+				if (!i->transparent) break;
+			}
+			std::cerr << "No such function " << name << std::endl;
+			context.fail();
+		}
+
+		/* Wraps slot in a cast to type, false if the types don't convert */
+		bool convert(NExpression*& slot, Type* type)
+		{
+			auto from = slot->type;
+			if (from == type) return true;
+			if (!((from == int64 || from == real) && (type == int64 || type == real || type == boolean))) return false;
+			auto conversion = new NCast(*new NIdentifier(typeName(type)), *slot);
+			conversion->type = type;
+			slot = conversion;
+			++casts;
+			return true;
+		}
+
+		void require(NExpression*& slot, Type* type)
+		{
+			if (!convert(slot, type)) {
+				std::cerr << "can't convert " << typeName(slot->type) << " to " << typeName(type) << std::endl;
+				context.fail();
+			}
+		}
+
+	public:
+		int casts = 0;
+
+		explicit TypeChecker(CodeGenContext& context) : context(context)
+		{
+			int64 = Type::getInt64Ty(context.llvmContext);
+			real = Type::getDoubleTy(context.llvmContext);
+			boolean = Type::getInt1Ty(context.llvmContext);
+			none = Type::getVoidTy(context.llvmContext);
+			push(false);
+			for (auto const& global : context.persistentGlobals) {
+				scopes.back().variables[global.first] = global.second.type;
+			}
+		}
+
+		Type* visitBool(NBool& node) { return node.type = boolean; }
+		Type* visitInteger(NInteger& node) { return node.type = int64; }
+		Type* visitDouble(NDouble& node) { return node.type = real; }
+		Type* visitIdentifier(NIdentifier& node) { return node.type = variable(node.name); }
+
+		Type* visitMethodCall(NMethodCall& node)
+		{
+			auto type = function(node.id.name);
+			if (node.arguments.size() != type->getNumParams()) {
+				std::cerr << node.id.name << " takes " << type->getNumParams() << " arguments, not " << node.arguments.size() << std::endl;
+				context.fail();
+			}
+			for (unsigned i = 0; i < node.arguments.size(); ++i) {
+				visit(*node.arguments[i]);
+				require(node.arguments[i], type->getParamType(i));
+			}
+			return node.type = type->getReturnType();
+		}
+
+		Type* visitBinaryOperator(NBinaryOperator& node)
+		{
+			auto lhs = visit(*node.lhs);
+			auto rhs = visit(*node.rhs);
+			if (node.op == TNOT) {
+				require(node.lhs, boolean);
+				return node.type = boolean;
+			}
+			if (node.op == TAND || node.op == TOR) {
+				require(node.lhs, boolean);
+				require(node.rhs, boolean);
+				return node.type = boolean;
+			}
+			if (isElementwise(node.op) && (isArray(lhs) || isArray(rhs))) {
+				/* Evaluated element by element in the type of the array assigned to */
+				return node.type = isArray(lhs) ? lhs : rhs;
+			}
+			if (lhs != int64 || rhs != int64) {
+				if (lhs != real && rhs != real) {
+					std::cerr << "can't apply binary operator to " << typeName(lhs) << " and " << typeName(rhs) << std::endl;
+					context.fail();
+				}
+				require(node.lhs, real);
+				require(node.rhs, real);
+			}
+			return node.type = isComparison(node.op) ? boolean : node.lhs->type;
+		}
+
+		Type* visitAssignment(NAssignment& node)
+		{
+			auto type = variable(node.lhs.name);
+			assignable(node.lhs.name);
+			visit(*node.rhs);
+			if (isArray(type)) {
+				checkLengths(*node.rhs, knownLength(node.lhs.name));
+				return node.type = type;
+			}
+			require(node.rhs, type);
+			return node.type = none;
+		}
+
+		Type* visitArrayIndex(NArrayIndex& node)
+		{
+			auto type = array(node.id.name);
+			visit(*node.index);
+			require(node.index, int64);
+			return node.type = context.arrayElementType(type);
+		}
+
+		Type* visitArrayAssignment(NArrayAssignment& node)
+		{
+			auto type = array(node.id.name);
+			visit(*node.index);
+			require(node.index, int64);
+			visit(*node.rhs);
+			require(node.rhs, context.arrayElementType(type));
+			return node.type = none;
+		}
+
+		Type* visitArrayLength(NArrayLength& node)
+		{
+			array(node.id.name);
+			return node.type = int64;
+		}
+
+		Type* visitBlock(NBlock& node)
+		{
+			Type* last = nullptr;
+			for (auto statement : node.statements) last = visit(*statement);
+			return node.type = last;
+		}
+
+		Type* visitExpressionStatement(NExpressionStatement& node) { return visit(*node.expression); }
+		Type* visitReturnStatement(NReturnStatement& node)
+		{
+			visit(*node.expression);
+			/* The script's own return is checked when main is generated */
+			if (!results.empty()) require(node.expression, results.back());
+			return node.expression->type;
+		}
+
+		Type* visitIfBlock(NIfBlock& node)
+		{
+			visit(*node.cond);
+			require(node.cond, boolean);
+			push(true);
+			auto thenType = visit(*node.thenblock);
+			scopes.pop_back();
+			push(true);
+			auto elseType = visit(*node.elseblock);
+			scopes.pop_back();
+			if (thenType != elseType) {
+				std::cerr << "elseblock and thenblock must have the same type!" << std::endl;
+				context.fail();
+			}
+			return node.type = thenType;
+		}
+
+		Type* visitWhileBlock(NWhileBlock& node)
+		{
+			visit(*node.cond);
+			require(node.cond, boolean);
+			push(true);
+			visit(node.doblock);
+			scopes.pop_back();
+			return boolean;
+		}
+
+		Type* visitForBlock(NForBlock& node)
+		{
+			visit(*node.from);
+			require(node.from, int64);
+			visit(*node.to);
+			require(node.to, int64);
+			if (node.step) {
+				visit(*node.step);
+				require(node.step, int64);
+			}
+			push(true);
+			scopes.back().variables[node.id.name] = int64;
+			visit(node.doblock);
+			scopes.pop_back();
+			return int64;
+		}
+
+		Type* visitParallelFor(NParallelFor& node)
+		{
+			visit(*node.from);
+			require(node.from, int64);
+			visit(*node.to);
+			require(node.to, int64);
+			auto result = node.reduction ? variable(node.reduction->name) : int64;
+			if (node.reduction) assignable(node.reduction->name);
+			/* The outlined body gets what it captures, so it sees everything around it */
+			push(true);
+			scopes.back().variables[node.id.name] = int64;
+			visit(node.doblock);
+			scopes.pop_back();
+			return result;
+		}
+
+		Type* visitVariableDefinition(NVariableDefinition& node)
+		{
+			auto type = typeOf(node.type, context);
+			if (node.immutable) {
+				/* A let is bound to its value, which can't see the name yet */
+				visit(*node.assignmentExpr);
+				if (!isArray(type)) require(node.assignmentExpr, type);
+				scopes.back().variables[node.id.name] = type;
+				scopes.back().immutable.insert(node.id.name);
+				scopes.back().lengths.erase(node.id.name);
+				return type;
+			}
+			scopes.back().variables[node.id.name] = type;
+			scopes.back().immutable.erase(node.id.name);
+			scopes.back().lengths.erase(node.id.name);
+			if (node.assignmentExpr) {
+				visit(*node.assignmentExpr);
+				if (!isArray(type)) require(node.assignmentExpr, type);
+			}
+			return type->getPointerTo();
+		}
+
+		Type* visitArrayDefinition(NArrayDefinition& node)
+		{
+			auto type = context.arrayType(typeOf(node.type, context));
+			visit(*node.size);
+			require(node.size, int64);
+			auto fixed = dyn_cast<NInteger>(node.size);
+			if (fixed && fixed->value < 0) {
+				std::cerr << "array " << node.id.name << " can't have a negative length" << std::endl;
+				context.fail();
+			}
+			scopes.back().variables[node.id.name] = type;
+			scopes.back().immutable.erase(node.id.name);
+			if (fixed) {
+				scopes.back().lengths[node.id.name] = fixed->value;
+			} else {
+				scopes.back().lengths.erase(node.id.name);
+			}
+			if (node.assignmentExpr) {
+				visit(*node.assignmentExpr);
+				checkLengths(*node.assignmentExpr, fixed ? fixed->value : -1);
+			}
+			return type->getPointerTo();
+		}
+
+		Type* visitExternDeclaration(NExternDeclaration& node)
+		{
+			std::vector<Type*> argTypes;
+			for (auto arg : node.arguments) argTypes.push_back(typeOf(arg->type, context));
+			auto type = FunctionType::get(typeOf(node.type, context), makeArrayRef(argTypes), false);
+			functions[node.id.name] = type;
+			return type->getPointerTo();
+		}
+
+		Type* visitFunctionDeclaration(NFunctionDeclaration& node)
+		{
+			std::vector<Type*> argTypes;
+			for (auto arg : node.arguments) argTypes.push_back(typeOf(arg->type, context));
+			auto type = FunctionType::get(typeOf(node.type, context), makeArrayRef(argTypes), false);
+			if (isArray(type->getReturnType())) {
+				/* Its elements live in the frame of the function, which is gone once it returns */
+				std::cerr << "function " << node.id.name << " can't return an array" << std::endl;
+				context.fail();
+			}
+			auto& table = node.local ? scopes.back().functions : functions;
+			/* The first definition wins and the body of a second one is never generated */
+			if (!table.emplace(node.id.name, type).second) return table[node.id.name]->getPointerTo();
+			push(node.local);
+			for (auto arg : node.arguments) scopes.back().variables[arg->id.name] = typeOf(arg->type, context);
+			results.push_back(type->getReturnType());
+			visit(node.block);
+			results.pop_back();
+			scopes.pop_back();
+			returns(node);
+			return type->getPointerTo();
+		}
+
+		Type* visitCast(NCast& node)
+		{
+			visit(*node.expression);
+			return node.type = typeOf(node.target, context);
+		}
+
+		Type* visitMatch(NMatch& node)
+		{
+			/* Cases are integer literals, a double or bool subject would match them only after a silent conversion */
+			if (visit(*node.subject) != int64) {
+				std::cerr << "can't match on " << typeName(node.subject->type) << ", only on int" << std::endl;
+				context.fail();
+			}
+			push(true);
+			auto type = visit(*node.otherwise);
+			scopes.pop_back();
+			for (auto& arm : node.cases) {
+				push(true);
+				auto armType = visit(*arm.second);
+				scopes.pop_back();
+				if (armType != type) {
+					std::cerr << "all arms of a match must have the same type!" << std::endl;
+					context.fail();
+				}
+			}
+			return node.type = type;
+		}
+
+		template <typename T>
+		Type* visitNode(T&) { return nullptr; }
+	};
+}
+
+int assignTypes(NBlock& root, CodeGenContext& context)
+{
+	TypeChecker checker(context);
+	checker.visit(root);
+	return checker.casts;
+}
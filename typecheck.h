@@ -0,0 +1,8 @@
+#pragma once
+
+class NBlock;
+class CodeGenContext;
+
+/* Gives every expression under root its static type and wraps the operands that need a conversion in NCast
+   nodes, so code generation knows all types up front. Returns how many casts it inserted. */
+int assignTypes(NBlock& root, CodeGenContext& context);